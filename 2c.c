@@ -15,10 +15,20 @@
 #include <assert.h>
 #include <ctype.h>
 #include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 #define MAX_NAME_LENGTH (512u)
+#define CACHE_LINE_BYTES (64u)
+#define HIGH_RATE_CYCLE_TIME_MS (100)
+#define FORMAT_MAX_DECIMALS (6u)
+#define ARRAY_MIN_ELEMENTS (3u)
+#define MUX_CASE_LIMIT (256u)
+#define PROFILE_HOT_MAX (4u)            /* messages tested before the dispatch switch */
+#define PROFILE_HOT_SHARE (0.5)         /* ...until they cover this share of the frames */
+#define PROFILE_HIGH_RATE_SHARE (0.01)  /* profiled messages treated like high rate ones */
+#define PROFILE_COLD_SHARE (0.001)      /* profiled messages rare enough to be cold */
 
 /* The float packing and unpacking is stolen and modified from
  * <https://beej.us/guide/bgnet/examples/pack2b.c>!
@@ -111,7 +121,13 @@ static inline double   unpack754_64(uint64_t i) { return unpack754(i, 64, 11); }
 
 
 
-static const bool swap_motorola = true;
+static uint64_t reverse_byte_order(uint64_t x)
+{
+	x = (x & 0x00000000FFFFFFFFuLL) << 32 | (x & 0xFFFFFFFF00000000uLL) >> 32;
+	x = (x & 0x0000FFFF0000FFFFuLL) << 16 | (x & 0xFFFF0000FFFF0000uLL) >> 16;
+	x = (x & 0x00FF00FF00FF00FFuLL) << 8  | (x & 0xFF00FF00FF00FF00uLL) >> 8;
+	return x;
+}
 
 static unsigned fix_start_bit(bool motorola, unsigned start, unsigned siglen)
 {
@@ -167,35 +183,190 @@ static int comment(signal_t *sig, FILE *o, const char *indent)
 			sig->offset);
 }
 
-static int signal2deserializer(signal_t *sig, const char *msg_name, FILE *o, const char *indent)
+/* last byte of the frame a signal occupies */
+static unsigned signal_last_byte(signal_t *sig)
 {
 	assert(sig);
-	assert(msg_name);
+	if (sig->endianess != endianess_motorola_e)
+		return (sig->start_bit + sig->bit_length - 1) / 8;
+	const unsigned first = (sig->start_bit % 8) + 1; /* bits in the first byte */
+	if (sig->bit_length <= first)
+		return sig->start_bit / 8;
+	return (sig->start_bit / 8) + ((sig->bit_length - first + 7) / 8);
+}
+
+static bool signal_is_motorola_single_byte(signal_t *sig)
+{
+	assert(sig);
+	return sig->endianess == endianess_motorola_e && sig->bit_length && (sig->start_bit % 8) >= (sig->bit_length - 1);
+}
+
+/* Motorola signals that fit within a single byte can be taken straight from
+ * the frame ('i') like Intel ones, only those spanning bytes need the frame
+ * byte swapped ('m'). The swap is made just wide enough to cover the bytes
+ * those signals use, or 0 if no swap is needed at all. */
+static bool signal_is_swapped(signal_t *sig)
+{
+	assert(sig);
+	return sig->endianess == endianess_motorola_e && !signal_is_motorola_single_byte(sig);
+}
+
+static unsigned msg_swap_width(can_msg_t *msg)
+{
+	assert(msg);
+	bool swapped = false;
+	unsigned last = 0, beyond = 0;
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		signal_t *sig = msg->sigs[i];
+		if (!signal_is_swapped(sig))
+			continue;
+		swapped = true;
+		const unsigned l = signal_last_byte(sig);
+		if (msg->dlc && l >= msg->dlc)
+			beyond = l > beyond ? l : beyond;
+		else
+			last = l > last ? l : last;
+	}
+	if (!swapped)
+		return 0;
+	/* A frame has no bytes past its DLC, so the swap is clamped to it. Only
+	 * a signal lying past the DLC, which msg_dlc_check warns about, can
+	 * widen it, as it could not be extracted otherwise. */
+	if (msg->dlc && last >= msg->dlc)
+		last = msg->dlc - 1;
+	last = beyond > last ? beyond : last;
+	if (last < 2)
+		return 16;
+	if (last < 4)
+		return 32;
+	return 64;
+}
+
+/* shift of the least significant bit of a signal in 'i' or 'm' */
+static unsigned signal_shift(signal_t *sig, unsigned swap)
+{
+	assert(sig);
+	const bool motorola = (sig->endianess == endianess_motorola_e);
+	if (!motorola)
+		return sig->start_bit;
+	if (signal_is_motorola_single_byte(sig))
+		return sig->start_bit - (sig->bit_length - 1);
+	return fix_start_bit(motorola, sig->start_bit, sig->bit_length) - (64 - swap);
+}
+
+static const char *swap_function(unsigned swap)
+{
+	switch (swap) {
+	case 16: return "reverse_byte_order16";
+	case 32: return "reverse_byte_order32";
+	case 64: return "reverse_byte_order";
+	}
+	return "";
+}
+
+static bool msg_wire_used(can_msg_t *msg)
+{
+	assert(msg);
+	for (size_t i = 0; i < msg->signal_count; i++)
+		if (!signal_is_swapped(msg->sigs[i]))
+			return true;
+	return false;
+}
+
+/* How signals are moved in and out of the frame */
+typedef enum {
+	EXTRACT_SHIFT_E, /* shift and mask on a 64-bit word */
+	EXTRACT_BMI2_E,  /* PEXT/PDEP on a 64-bit word */
+	EXTRACT_WORDS_E, /* shift and mask on two 32-bit halves */
+} extract_e;
+
+/* Variables used by the 32-bit word path of a message */
+typedef struct {
+	bool x, x64; /* temporaries for signals of up to 32 bits and for longer ones */
+	bool i[2];   /* low and high halves of the frame */
+	bool m[2];   /* low and high halves of the byte swapped frame */
+} word_use_t;
+
+/* Numbered signals ("Cell_V_01" to "Cell_V_96") that differ only in their
+ * position in the frame are turned into an array in the message structure,
+ * moved in and out of the frame by a loop and given a single encode and
+ * decode function taking an index. The elements stay in the message as
+ * signals, so everything that works on the frame is unaffected. Multiplexed
+ * elements are split into pages of the same layout, one page for each of a
+ * consecutive range of multiplexor values. The arrays of a message are
+ * found once and kept in it, see msg_arrays. */
+typedef struct signal_array {
+	char name[MAX_NAME_LENGTH]; /* name of the array in the structure */
+	signal_t **elements;        /* in the order of the number in their name */
+	size_t count;               /* number of elements */
+	size_t page;                /* elements per multiplexed page, or 'count' */
+	unsigned shift;             /* shift of the first element of a page */
+	int stride;                 /* shift from one element of a page to the next */
+	unsigned switchval;         /* multiplexor value of the first page */
+} signal_array_t;
+
+static void signal_word_use(signal_t *sig, unsigned swap, word_use_t *u)
+{
+	assert(sig);
+	assert(u);
+	const unsigned start = signal_shift(sig, swap);
+	bool *w = signal_is_swapped(sig) ? u->m : u->i;
+	if (sig->bit_length > 32)
+		u->x64 = true;
+	else
+		u->x = true;
+	if (start < 32)
+		w[0] = true;
+	if ((start + sig->bit_length) > 32)
+		w[1] = true;
+}
+
+static int signal2deserializer_words(signal_t *sig, const char *record, unsigned swap, FILE *o, const char *indent)
+{
+	assert(sig);
+	assert(record);
 	assert(o);
-	const bool motorola   = (sig->endianess == endianess_motorola_e);
-	const unsigned start  = fix_start_bit(motorola, sig->start_bit, sig->bit_length);
+	const char source = signal_is_swapped(sig) ? 'm' : 'i';
+	const unsigned start  = signal_shift(sig, swap);
 	const unsigned length = sig->bit_length;
+	const unsigned word = start / 32, shift = start % 32;
 	const uint64_t mask = length == 64 ?
 		0xFFFFFFFFFFFFFFFFuLL :
 		(1uLL << length) - 1uLL;
 
-	if (comment(sig, o, indent) < 0)
+	if ((start + length) > 64) {
+		error("signal %s does not fit in the frame (fix the dbc file)", sig->name);
 		return -1;
+	}
 
-	if (start)
-		fprintf(o, "%sx = (%c >> %d) & 0x%"PRIx64";\n", indent, motorola ? 'm' : 'i', start, mask);
-	else
-		fprintf(o, "%sx = %c & 0x%"PRIx64";\n", indent, motorola ? 'm' : 'i',  mask);
+	if (length > 32) {
+		const uint64_t high = mask >> 32;
+		if (shift)
+			fprintf(o, "%sx64 = ((uint64_t)((%c1 >> %u) & 0x%"PRIx64") << 32) | ((%c0 >> %u) | (%c1 << %u));\n",
+				indent, source, shift, high, source, shift, source, 32 - shift);
+		else
+			fprintf(o, "%sx64 = ((uint64_t)(%c1 & 0x%"PRIx64") << 32) | %c0;\n", indent, source, mask >> 32, source);
+	} else if ((shift + length) <= 32) {
+		if (shift)
+			fprintf(o, "%sx = (%c%u >> %u) & 0x%"PRIx64";\n", indent, source, word, shift, mask);
+		else if (length == 32)
+			fprintf(o, "%sx = %c%u;\n", indent, source, word);
+		else
+			fprintf(o, "%sx = %c%u & 0x%"PRIx64";\n", indent, source, word, mask);
+	} else {
+		fprintf(o, "%sx = ((%c0 >> %u) | (%c1 << %u)) & 0x%"PRIx64";\n", indent, source, shift, source, 32 - shift, mask);
+	}
 
+	const char *x = length > 32 ? "x64" : "x";
 	if (sig->is_floating) {
 		assert(length == 32 || length == 64);
-		if (fprintf(o, "%so->%s.%s = unpack754_%d(x);\n", indent, msg_name, sig->name, length) < 0)
+		if (fprintf(o, "%s%s%s = unpack754_%d(%s);\n", indent, record, sig->name, length, x) < 0)
 			return -1;
 		return 0;
 	}
 
 	if (sig->is_signed) {
-		const uint64_t top = (1uL << (length - 1));
+		const uint64_t top = (1uLL << (length - 1));
 		uint64_t negative = ~mask;
 		if (length <= 32)
 			negative &= 0xFFFFFFFF;
@@ -204,19 +375,131 @@ static int signal2deserializer(signal_t *sig, const char *msg_name, FILE *o, con
 		if (length <= 8)
 			negative &= 0xFF;
 		if (negative)
-			fprintf(o, "%sx = (x & 0x%"PRIx64") ? (x | 0x%"PRIx64") : x; \n", indent, top, negative);
+			fprintf(o, "%s%s = (%s & 0x%"PRIx64"%s) ? (%s | 0x%"PRIx64"%s) : %s; \n",
+				indent, x, x, top, length > 32 ? "uLL" : "", x, negative, length > 32 ? "uLL" : "", x);
+	}
+
+	fprintf(o, "%s%s%s = %s;\n", indent, record, sig->name, x);
+	return 0;
+}
+
+static int signal2serializer_words(signal_t *sig, const char *record, unsigned swap, FILE *o, const char *indent)
+{
+	assert(sig);
+	assert(record);
+	assert(o);
+	const char source = signal_is_swapped(sig) ? 'm' : 'i';
+	const unsigned start  = signal_shift(sig, swap);
+	const unsigned length = sig->bit_length;
+	const unsigned word = start / 32, shift = start % 32;
+	const uint64_t mask = length == 64 ?
+		0xFFFFFFFFFFFFFFFFuLL :
+		(1uLL << length) - 1uLL;
+
+	if ((start + length) > 64) {
+		error("signal %s does not fit in the frame (fix the dbc file)", sig->name);
+		return -1;
+	}
+
+	if (length > 32) {
+		if (sig->is_floating)
+			fprintf(o, "%sx64 = pack754_%u(%s%s);\n", indent, length, record, sig->name);
+		else
+			fprintf(o, "%sx64 = ((uint64_t)(%s%s)) & 0x%"PRIx64"uLL;\n", indent, record, sig->name, mask);
+		if (shift) {
+			fprintf(o, "%s%c0 |= (uint32_t)x64 << %u;\n", indent, source, shift);
+			fprintf(o, "%s%c1 |= ((uint32_t)(x64 >> 32) << %u) | ((uint32_t)x64 >> %u);\n", indent, source, shift, 32 - shift);
+		} else {
+			fprintf(o, "%s%c0 |= (uint32_t)x64;\n", indent, source);
+			fprintf(o, "%s%c1 |= (uint32_t)(x64 >> 32);\n", indent, source);
+		}
+		return 0;
+	}
+
+	if (sig->is_floating) {
+		assert(length == 32);
+		fprintf(o, "%sx = (uint32_t)pack754_32(%s%s);\n", indent, record, sig->name);
+	} else {
+		fprintf(o, "%sx = ((%s)(%s%s)) & 0x%"PRIx64";\n", indent, determine_unsigned_type(length), record, sig->name, mask);
+	}
+	if ((shift + length) <= 32) {
+		if (shift)
+			fprintf(o, "%s%c%u |= x << %u;\n", indent, source, word, shift);
+		else
+			fprintf(o, "%s%c%u |= x;\n", indent, source, word);
+	} else {
+		fprintf(o, "%s%c0 |= x << %u;\n", indent, source, shift);
+		fprintf(o, "%s%c1 |= x >> %u;\n", indent, source, 32 - shift);
+	}
+	return 0;
+}
+
+/* sign extend the signal held in 'x' up to the size of its type */
+static void signal_sign_extend(signal_t *sig, FILE *o, const char *indent)
+{
+	assert(sig);
+	assert(o);
+	assert(indent);
+	const unsigned length = sig->bit_length;
+	if (!sig->is_signed)
+		return;
+	const uint64_t mask = length == 64 ?
+		0xFFFFFFFFFFFFFFFFuLL :
+		(1uLL << length) - 1uLL;
+	const uint64_t top = (1uL << (length - 1));
+	uint64_t negative = ~mask;
+	if (length <= 32)
+		negative &= 0xFFFFFFFF;
+	if (length <= 16)
+		negative &= 0xFFFF;
+	if (length <= 8)
+		negative &= 0xFF;
+	if (negative)
+		fprintf(o, "%sx = (x & 0x%"PRIx64") ? (x | 0x%"PRIx64") : x; \n", indent, top, negative);
+}
+
+static int signal2deserializer(signal_t *sig, const char *record, unsigned swap, extract_e extract, FILE *o, const char *indent)
+{
+	assert(sig);
+	assert(record);
+	assert(o);
+	const char source = signal_is_swapped(sig) ? 'm' : 'i';
+	const unsigned start  = signal_shift(sig, swap);
+	const unsigned length = sig->bit_length;
+	const uint64_t mask = length == 64 ?
+		0xFFFFFFFFFFFFFFFFuLL :
+		(1uLL << length) - 1uLL;
+
+	if (comment(sig, o, indent) < 0)
+		return -1;
+
+	if (extract == EXTRACT_WORDS_E)
+		return signal2deserializer_words(sig, record, swap, o, indent);
+
+	if (start && extract == EXTRACT_BMI2_E)
+		fprintf(o, "%sx = _pext_u64(%c, 0x%"PRIx64"uLL);\n", indent, source, mask << start);
+	else if (start)
+		fprintf(o, "%sx = (%c >> %d) & 0x%"PRIx64";\n", indent, source, start, mask);
+	else
+		fprintf(o, "%sx = %c & 0x%"PRIx64";\n", indent, source,  mask);
+
+	if (sig->is_floating) {
+		assert(length == 32 || length == 64);
+		if (fprintf(o, "%s%s%s = unpack754_%d(x);\n", indent, record, sig->name, length) < 0)
+			return -1;
+		return 0;
 	}
 
-	fprintf(o, "%so->%s.%s = x;\n", indent, msg_name, sig->name);
+	signal_sign_extend(sig, o, indent);
+	fprintf(o, "%s%s%s = x;\n", indent, record, sig->name);
 	return 0;
 }
 
-static int signal2serializer(signal_t *sig, const char *msg_name, FILE *o, const char *indent)
+static int signal2serializer(signal_t *sig, const char *record, unsigned swap, extract_e extract, FILE *o, const char *indent)
 {
 	assert(sig);
 	assert(o);
-	bool motorola = (sig->endianess == endianess_motorola_e);
-	int start = fix_start_bit(motorola, sig->start_bit, sig->bit_length);
+	const unsigned start = signal_shift(sig, swap);
 
 	uint64_t mask = sig->bit_length == 64 ?
 		0xFFFFFFFFFFFFFFFFuLL :
@@ -225,31 +508,44 @@ static int signal2serializer(signal_t *sig, const char *msg_name, FILE *o, const
 	if (comment(sig, o, indent) < 0)
 		return -1;
 
+	if (extract == EXTRACT_WORDS_E)
+		return signal2serializer_words(sig, record, swap, o, indent);
+
+	if (start && extract == EXTRACT_BMI2_E) {
+		if (sig->is_floating)
+			fprintf(o, "%sx = _pdep_u64(pack754_%u(%s%s), 0x%"PRIx64"uLL);\n", indent, sig->bit_length, record, sig->name, mask << start);
+		else
+			fprintf(o, "%sx = _pdep_u64((%s)(%s%s), 0x%"PRIx64"uLL);\n", indent, determine_unsigned_type(sig->bit_length), record, sig->name, mask << start);
+		fprintf(o, "%s%c |= x;\n", indent, signal_is_swapped(sig) ? 'm' : 'i');
+		return 0;
+	}
+
 	if (sig->is_floating) {
 		assert(sig->bit_length == 32 || sig->bit_length == 64);
-		fprintf(o, "%sx = pack754_%u(o->%s.%s) & 0x%"PRIx64";\n", indent, sig->bit_length, msg_name, sig->name, mask);
+		fprintf(o, "%sx = pack754_%u(%s%s) & 0x%"PRIx64";\n", indent, sig->bit_length, record, sig->name, mask);
 	} else {
-		fprintf(o, "%sx = ((%s)(o->%s.%s)) & 0x%"PRIx64";\n", indent, determine_unsigned_type(sig->bit_length), msg_name, sig->name, mask);
+		fprintf(o, "%sx = ((%s)(%s%s)) & 0x%"PRIx64";\n", indent, determine_unsigned_type(sig->bit_length), record, sig->name, mask);
 	}
 	if (start)
 		fprintf(o, "%sx <<= %u; \n", indent, start);
-	fprintf(o, "%s%c |= x;\n", indent, motorola ? 'm' : 'i');
+	fprintf(o, "%s%c |= x;\n", indent, signal_is_swapped(sig) ? 'm' : 'i');
 	return 0;
 }
 
-static int signal2print(signal_t *sig, unsigned id, const char *msg_name, FILE *o)
+static int signal2print(signal_t *sig, unsigned id, const char *msg_name, const char *field, FILE *o)
 {
 	UNUSED(id);
 	/*super lazy*/
 	if (sig->is_floating)
-		return fprintf(o, "\tr = print_helper(r, fprintf(output, \"%s = (wire: %%g)\\n\", (double)(o->%s.%s)));\n", sig->name, msg_name, sig->name);
-	return fprintf(o, "\tr = print_helper(r, fprintf(output, \"%s = (wire: %%.0f)\\n\", (double)(o->%s.%s)));\n", sig->name, msg_name, sig->name);
+		return fprintf(o, "\tr = print_helper(r, fprintf(output, \"%s = (wire: %%g)\\n\", (double)(o->%s.%s)));\n", field, msg_name, field);
+	return fprintf(o, "\tr = print_helper(r, fprintf(output, \"%s = (wire: %%.0f)\\n\", (double)(o->%s.%s)));\n", field, msg_name, field);
 }
 
-static int signal2type(signal_t *sig, FILE *o)
+static int signal2type(signal_t *sig, FILE *o, const char *indent)
 {
 	assert(sig);
 	assert(o);
+	assert(indent);
 	const unsigned length = sig->bit_length;
 	const char *type = determine_type(length, sig->is_signed, sig->is_floating);
 
@@ -266,14 +562,14 @@ static int signal2type(signal_t *sig, FILE *o)
 	}
 
 	if (sig->comment) {
-		fprintf(o, "\t/* %s: %s */\n", sig->name, sig->comment);
-		return fprintf(o, "\t/* scaling %.1f, offset %.1f, units %s %s */\n\t%s %s;\n",
-				sig->scaling, sig->offset, sig->units[0] ? sig->units : "none",
+		fprintf(o, "%s/* %s: %s */\n", indent, sig->name, sig->comment);
+		return fprintf(o, "%s/* scaling %.1f, offset %.1f, units %s %s */\n%s%s %s;\n",
+				indent, sig->scaling, sig->offset, sig->units[0] ? sig->units : "none",
 				sig->is_floating ? ", floating" : "",
-				type, sig->name);
+				indent, type, sig->name);
 	} else {
-		return fprintf(o, "\t%s %s; /* scaling %.1f, offset %.1f, units %s %s */\n",
-				type, sig->name, sig->scaling, sig->offset, sig->units[0] ? sig->units : "none",
+		return fprintf(o, "%s%s %s; /* scaling %.1f, offset %.1f, units %s %s */\n",
+				indent, type, sig->name, sig->scaling, sig->offset, sig->units[0] ? sig->units : "none",
 				sig->is_floating ? ", floating" : "");
 	}
 }
@@ -308,27 +604,154 @@ static int64_t signed_min(signal_t *sig)
 	return ~signed_max(sig);
 }
 
-static int signal2scaling_encode(const char *msgname, unsigned id, signal_t *sig, FILE *o, bool header, const char *god, dbc2c_options_t *copts)
+/* The value a constant has once printed into the generated code with "%g",
+ * anything computed here must match what the generated arithmetic does. */
+static double as_printed(double d)
+{
+	char b[64] = {0};
+	snprintf(b, sizeof(b) - 1, "%g", d);
+	return strtod(b, NULL);
+}
+
+/* Raw values are handled as an offset 'u' from the smallest value the signal
+ * can hold, so that signed and unsigned signals of any width are ordered the
+ * same way. */
+static int64_t signal_raw_signed(signal_t *sig, uint64_t u)
 {
-	assert(msgname);
 	assert(sig);
-	assert(o);
-	assert(copts);
-	const char *type = determine_type(sig->bit_length, sig->is_signed, sig->is_floating);
-	if (sig->scaling != 1.0 || sig->offset != 0.0)
-		type = "double";
-	if (copts->use_id_in_name)
-		fprintf(o, "int encode_can_0x%03x_%s(can_obj_%s_t *o, %s in)", id, sig->name, god, copts->use_doubles_for_encoding ? "double" : type);
+	return (int64_t)(u + (uint64_t)signed_min(sig));
+}
+
+/* The physical value of a raw value, computed exactly as the generated decode
+ * function computes it. */
+static double signal_raw2phys(signal_t *sig, uint64_t u)
+{
+	assert(sig);
+	double rval = sig->is_signed ? (double)signal_raw_signed(sig, u) : (double)u;
+	if (sig->scaling != 1.0)
+		rval *= as_printed(sig->scaling);
+	if (sig->offset != 0.0)
+		rval += as_printed(sig->offset);
+	return rval;
+}
+
+static bool raw_predicate(signal_t *sig, uint64_t u, double limit, bool above)
+{
+	const double p = signal_raw2phys(sig, u);
+	return above ? p >= limit : p <= limit;
+}
+
+/* Binary search for the first (or last) raw value for which a predicate that
+ * changes only once over the raw range holds, false if it never holds. */
+static bool raw_search(signal_t *sig, double limit, bool above, bool first, uint64_t *u)
+{
+	assert(sig);
+	assert(u);
+	uint64_t lo = 0, hi = unsigned_max(sig);
+	if (!raw_predicate(sig, first ? hi : lo, limit, above))
+		return false;
+	while (lo < hi) {
+		if (first) {
+			const uint64_t mid = lo + (hi - lo) / 2;
+			if (raw_predicate(sig, mid, limit, above))
+				hi = mid;
+			else
+				lo = mid + 1;
+		} else {
+			const uint64_t mid = hi - (hi - lo) / 2;
+			if (raw_predicate(sig, mid, limit, above))
+				lo = mid;
+			else
+				hi = mid - 1;
+		}
+	}
+	*u = lo;
+	return true;
+}
+
+typedef struct {
+	uint64_t lo, hi;         /* valid raw values, as offsets (see 'signal_raw_signed') */
+	bool check_lo, check_hi; /* false if the bound is the limit of the bit-width anyway */
+} raw_bounds_t;
+
+/* Convert the [minimum, maximum] range of an integer signal into the range
+ * of raw values that decode into it. Scaling and offset are monotonic, so
+ * the valid raw values form a single range and rounding is accounted for
+ * by searching with the same arithmetic the decode function uses. False is
+ * returned if the signal has no range to check. */
+static bool signal_raw_bounds(signal_t *sig, raw_bounds_t *b)
+{
+	assert(sig);
+	assert(b);
+	if (sig->is_floating || !signal_are_min_max_valid(sig))
+		return false;
+	const double minimum = as_printed(sig->minimum);
+	const double maximum = as_printed(sig->maximum);
+	const uint64_t top = unsigned_max(sig);
+	bool found = false;
+	if (sig->scaling > 0.0)
+		found = raw_search(sig, minimum, true, true, &b->lo) && raw_search(sig, maximum, false, false, &b->hi);
 	else
-		fprintf(o, "int encode_can_%s(can_obj_%s_t *o, %s in)", sig->name, god, copts->use_doubles_for_encoding ? "double" : type);
+		found = raw_search(sig, maximum, false, true, &b->lo) && raw_search(sig, minimum, true, false, &b->hi);
+	if (!found || b->lo > b->hi) { /* nothing is valid, fail every check */
+		b->lo = 1;
+		b->hi = 0;
+	}
+	b->check_lo = b->lo > 0;
+	b->check_hi = b->hi < top;
+	return b->check_lo || b->check_hi;
+}
 
-	if (header)
-		return fputs(";\n", o);
-	fputs(" {\n", o);
-	if (copts->generate_asserts) {
-		fputs("\tassert(o);\n", o);
+/* Print a raw value as a C literal of the signal's type */
+static void raw_literal(char *b, size_t maxlen, signal_t *sig, uint64_t u)
+{
+	assert(b);
+	assert(sig);
+	if (sig->is_signed) {
+		const int64_t r = signal_raw_signed(sig, u);
+		if (r == INT64_MIN)
+			snprintf(b, maxlen - 1, "INT64_MIN");
+		else
+			snprintf(b, maxlen - 1, "%"PRId64, r);
+	} else {
+		snprintf(b, maxlen - 1, "%"PRIu64"%s", u, u > INT64_MAX ? "uLL" : "");
 	}
-	if (signal_are_min_max_valid(sig)) {
+}
+
+static double raw_double(signal_t *sig, uint64_t u)
+{
+	assert(sig);
+	return sig->is_signed ? (double)signal_raw_signed(sig, u) : (double)u;
+}
+
+/* The raw values an encode function accepts, see 'signal_raw_bounds'. The
+ * value passed in can be wider than the signal, a double or an integer type
+ * with more bits, so a bound at the limit of the bit-width is checked too,
+ * except for the lowest value of an unsigned type. */
+static bool signal_encode_bounds(signal_t *sig, bool is_double, raw_bounds_t *b)
+{
+	assert(sig);
+	assert(b);
+	if (sig->is_floating || !signal_are_min_max_valid(sig))
+		return false;
+	signal_raw_bounds(sig, b);
+	const unsigned length = sig->bit_length;
+	const bool wider = is_double || !(length == 8 || length == 16 || length == 32 || length == 64);
+	b->check_lo = b->check_lo || (wider && (is_double || sig->is_signed));
+	b->check_hi = b->check_hi || wider;
+	return b->check_lo || b->check_hi;
+}
+
+/* Scale the physical value 'in' to its wire value and then range check it,
+ * 'clear' is an optional statement executed before a range check fails.
+ * Integer signals are rounded to the nearest raw value and checked against
+ * the raw values that decode to within [minimum, maximum], so encode and
+ * decode agree on what is valid. */
+static int signal2encode_scaling(signal_t *sig, FILE *o, const char *clear, bool is_double)
+{
+	assert(sig);
+	assert(o);
+	if (sig->is_floating && signal_are_min_max_valid(sig)) {
 		bool gmax = true;
 		bool gmin = true;
 
@@ -339,13 +762,10 @@ static int signal2scaling_encode(const char *msgname, unsigned id, signal_t *sig
 			gmin = sig->minimum > 0.0;
 			gmax = sig->maximum < unsigned_max(sig);
 		}
-		if (sig->is_floating) {
-			gmax = true;
-			gmax = true;
-		}
+		gmax = true;
 
-		if (gmin || gmax)
-			fprintf(o, "\to->%s.%s = 0;\n", msgname, sig->name); // cast!
+		if ((gmin || gmax) && clear)
+			fprintf(o, "\t%s\n", clear);
 		if (gmin)
 			fprintf(o, "\tif (in < %g)\n\t\treturn -1;\n", sig->minimum);
 		if (gmax)
@@ -358,67 +778,340 @@ static int signal2scaling_encode(const char *msgname, unsigned id, signal_t *sig
 		fprintf(o, "\tin += %g;\n", -1.0 * sig->offset);
 	if (sig->scaling != 1.0)
 		fprintf(o, "\tin *= %g;\n", 1.0 / sig->scaling);
-	fprintf(o, "\to->%s.%s = in;\n", msgname, sig->name); // cast!
-	return fputs("\treturn 0;\n}\n\n", o);
+	if (is_double && !sig->is_floating)
+		fputs("\tin = in < 0.0 ? in - 0.5 : in + 0.5;\n", o);
+
+	raw_bounds_t b;
+	if (!signal_encode_bounds(sig, is_double, &b))
+		return 0;
+	char lo[64] = {0}, hi[64] = {0};
+	if (is_double) { /* the conversion to the raw type truncates towards zero */
+		const double l = raw_double(sig, b.lo), h = raw_double(sig, b.hi);
+		if (l > 0.0 || l - 1.0 == l)
+			snprintf(lo, sizeof(lo) - 1, "(in < %.1f)", l);
+		else
+			snprintf(lo, sizeof(lo) - 1, "(in <= %.1f)", l - 1.0);
+		if (h < 0.0)
+			snprintf(hi, sizeof(hi) - 1, "(in > %.1f)", h);
+		else
+			snprintf(hi, sizeof(hi) - 1, "(in >= %.1f)", h + 1.0);
+	} else {
+		char l[32] = {0}, h[32] = {0};
+		raw_literal(l, sizeof(l), sig, b.lo);
+		raw_literal(h, sizeof(h), sig, b.hi);
+		snprintf(lo, sizeof(lo) - 1, "(in < %s)", l);
+		snprintf(hi, sizeof(hi) - 1, "(in > %s)", h);
+	}
+	fprintf(o, "\tif (%s%s%s) {\n",
+			b.check_lo ? lo : "",
+			b.check_lo && b.check_hi ? " || " : "",
+			b.check_hi ? hi : "");
+	if (clear)
+		fprintf(o, "\t\t%s\n", clear);
+	return fputs("\t\treturn -1;\n\t}\n", o);
+}
+
+static const char *signal_encode_type(signal_t *sig, dbc2c_options_t *copts)
+{
+	assert(sig);
+	assert(copts);
+	if (copts->use_doubles_for_encoding || sig->scaling != 1.0 || sig->offset != 0.0)
+		return "double";
+	return determine_type(sig->bit_length, sig->is_signed, sig->is_floating);
+}
+
+/* The name of the encode and decode functions, their extra index parameter
+ * and the field they access, which differ for the elements of an array */
+static void signal_scaling_names(signal_t *sig, const signal_array_t *array, const char **name, const char **index, char *field, size_t maxlen)
+{
+	assert(sig);
+	assert(name);
+	assert(index);
+	assert(field);
+	*name = array ? array->name : sig->name;
+	*index = array ? ", unsigned n" : "";
+	snprintf(field, maxlen - 1, "%s%s", *name, array ? "[n]" : "");
+}
+
+/* With '-H' the accessor definitions go in the header and every module that
+ * includes it gets its own, inlinable, copy */
+static void accessor_linkage(FILE *o, bool header, dbc2c_options_t *copts)
+{
+	assert(o);
+	assert(copts);
+	if (!header && copts->header_only)
+		fputs("static inline ", o);
 }
 
-static int signal2scaling_decode(const char *msgname, unsigned id, signal_t *sig, FILE *o, bool header, const char *god, dbc2c_options_t *copts)
+/* With 'raw' set the conversion is done by that helper, see 'signal_raw_helper' */
+static int signal2scaling_encode(const char *msgname, unsigned id, signal_t *sig, FILE *o, bool header, const char *god, const signal_array_t *array, const char *raw, dbc2c_options_t *copts)
 {
 	assert(msgname);
 	assert(sig);
 	assert(o);
 	assert(copts);
-	const char *type = determine_type(sig->bit_length, sig->is_signed, sig->is_floating);
-	if (sig->scaling != 1.0 || sig->offset != 0.0)
-		type = "double";
+	const char *type = signal_encode_type(sig, copts);
+	const char *name = NULL, *index = NULL;
+	char field[MAX_NAME_LENGTH * 2] = {0};
+	signal_scaling_names(sig, array, &name, &index, field, sizeof(field));
+	accessor_linkage(o, header, copts);
 	if (copts->use_id_in_name)
-		fprintf(o, "int decode_can_0x%03x_%s(const can_obj_%s_t *o, %s *out)", id, sig->name, god, copts->use_doubles_for_encoding ? "double" : type);
+		fprintf(o, "int encode_can_0x%03x_%s(can_obj_%s_t *o%s, %s in)", id, name, god, index, type);
 	else
-		fprintf(o, "int decode_can_%s(const can_obj_%s_t *o, %s *out)", sig->name, god, copts->use_doubles_for_encoding ? "double" : type);
+		fprintf(o, "int encode_can_%s(can_obj_%s_t *o%s, %s in)", name, god, index, type);
+
 	if (header)
 		return fputs(";\n", o);
 	fputs(" {\n", o);
 	if (copts->generate_asserts) {
 		fputs("\tassert(o);\n", o);
-		fputs("\tassert(out);\n", o);
 	}
-	fprintf(o, "\t%s rval = (%s)(o->%s.%s);\n", type, type, msgname, sig->name);
-	if (sig->scaling == 0.0)
-		error("invalid scaling factor (fix your DBC file)");
-	if (sig->scaling != 1.0)
-		fprintf(o, "\trval *= %g;\n", sig->scaling);
-	if (sig->offset != 0.0)
-		fprintf(o, "\trval += %g;\n", sig->offset);
-	if (signal_are_min_max_valid(sig)) {
-		bool gmax = true;
-		bool gmin = true;
+	if (array)
+		fprintf(o, "\tif (n >= %zu)\n\t\treturn -1;\n", array->count);
+	/* with '-q' the write is seen whole or not at all by the readers */
+	const bool seq = copts->use_sequence_counter;
+	if (raw && seq)
+		return fprintf(o, "\tint r = 0;\n\tDBCC_SEQ_WRITE(o->%s_seq, r = %s(in, &o->%s.%s));\n\treturn r;\n}\n\n", msgname, raw, msgname, field);
+	if (raw)
+		return fprintf(o, "\treturn %s(in, &o->%s.%s);\n}\n\n", raw, msgname, field);
+	char clear[MAX_NAME_LENGTH * 4] = {0};
+	if (seq)
+		snprintf(clear, sizeof(clear) - 1, "DBCC_SEQ_WRITE(o->%s_seq, o->%s.%s = 0);", msgname, msgname, field);
+	else
+		snprintf(clear, sizeof(clear) - 1, "o->%s.%s = 0;", msgname, field); // cast!
+	if (signal2encode_scaling(sig, o, clear, !strcmp(type, "double")) < 0)
+		return -1;
+	if (seq)
+		fprintf(o, "\tDBCC_SEQ_WRITE(o->%s_seq, o->%s.%s = in);\n", msgname, msgname, field);
+	else
+		fprintf(o, "\to->%s.%s = in;\n", msgname, field); // cast!
+	return fputs("\treturn 0;\n}\n\n", o);
+}
 
-		if (sig->is_signed) { /**@warning comparison may fail because of limits of double size */
-			gmin = sig->minimum > signed_min(sig);
-			gmax = sig->maximum < signed_max(sig);
-		} else {
-			gmin = sig->minimum > 0.0;
-			gmax = sig->maximum < unsigned_max(sig);
-		}
-		if (sig->is_floating) {
-			gmax = true;
-			gmax = true;
-		}
+static void signal_function_name(char *fname, size_t maxlen, const char *prefix, unsigned id, signal_t *sig, dbc2c_options_t *copts)
+{
+	assert(fname);
+	assert(prefix);
+	assert(sig);
+	assert(copts);
+	if (copts->use_id_in_name)
+		snprintf(fname, maxlen - 1, "%s_can_0x%03x_%s", prefix, id, sig->name);
+	else
+		snprintf(fname, maxlen - 1, "%s_can_%s", prefix, sig->name);
+}
 
-		if (!gmax && !gmin) {
-			fputs("\t*out = rval;\n", o);
-			fputs("\treturn 0;\n", o);
-		} else {
-			if (gmin && gmax) {
-				fprintf(o, "\tif ((rval >= %g) && (rval <= %g)) {\n", sig->minimum, sig->maximum);
-			} else if (gmax) {
-				fprintf(o, "\tif (rval <= %g) {\n", sig->maximum);
-			} else if (gmin) {
-				fprintf(o, "\tif (rval >= %g) {\n", sig->minimum);
-			}
-			fputs("\t\t*out = rval;\n", o);
-			fputs("\t\treturn 0;\n", o);
-			fputs("\t} else {\n", o);
+/* Insert a raw value into an already packed frame, leaving all other bits
+ * of the frame (including those not described by the DBC) untouched. The
+ * frame is in the same format as given to 'unpack_message'. */
+static int signal2repack(unsigned id, signal_t *sig, FILE *o, bool header, dbc2c_options_t *copts)
+{
+	assert(sig);
+	assert(o);
+	assert(copts);
+	const bool motorola = signal_is_swapped(sig);
+	const unsigned start = signal_shift(sig, 64);
+	const uint64_t mask = sig->bit_length == 64 ?
+		0xFFFFFFFFFFFFFFFFuLL :
+		(1uLL << sig->bit_length) - 1uLL;
+	char fname[MAX_NAME_LENGTH] = {0};
+	signal_function_name(fname, MAX_NAME_LENGTH, "repack", id, sig, copts);
+	fprintf(o, "int %s(uint64_t *frame, %s in)", fname, determine_type(sig->bit_length, sig->is_signed, sig->is_floating));
+	if (header)
+		return fputs(";\n", o);
+	fputs(" {\n", o);
+	if (copts->generate_asserts)
+		fputs("\tassert(frame);\n", o);
+	if (comment(sig, o, "\t") < 0)
+		return -1;
+	if (sig->is_floating)
+		fprintf(o, "\tregister uint64_t x = pack754_%u(in) & 0x%"PRIx64";\n", sig->bit_length, mask);
+	else
+		fprintf(o, "\tregister uint64_t x = ((uint64_t)in) & 0x%"PRIx64";\n", mask);
+	if (start)
+		fprintf(o, "\tx <<= %u;\n", start);
+	if (motorola)
+		fprintf(o, "\t*frame = (*frame & 0x%"PRIx64"uLL) | reverse_byte_order(x);\n", ~reverse_byte_order(mask << start));
+	else
+		fprintf(o, "\t*frame = (*frame & 0x%"PRIx64"uLL) | x;\n", ~(mask << start));
+	return fputs("\treturn 0;\n}\n\n", o);
+}
+
+/* Encode a physical value and then repack it into a frame */
+static int signal2patch(unsigned id, signal_t *sig, FILE *o, bool header, dbc2c_options_t *copts)
+{
+	assert(sig);
+	assert(o);
+	assert(copts);
+	char fname[MAX_NAME_LENGTH] = {0};
+	signal_function_name(fname, MAX_NAME_LENGTH, "patch", id, sig, copts);
+	fprintf(o, "int %s(uint64_t *frame, %s in)", fname, signal_encode_type(sig, copts));
+	if (header)
+		return fputs(";\n", o);
+	fputs(" {\n", o);
+	if (copts->generate_asserts)
+		fputs("\tassert(frame);\n", o);
+	if (signal2encode_scaling(sig, o, NULL, !strcmp(signal_encode_type(sig, copts), "double")) < 0)
+		return -1;
+	signal_function_name(fname, MAX_NAME_LENGTH, "repack", id, sig, copts);
+	fprintf(o, "\treturn %s(frame, in);\n", fname);
+	return fputs("}\n\n", o);
+}
+
+/* Only scaled signals of 8 bits or less are worth a table, anything else is
+ * either already a single cast or would need too large a table. */
+static bool signal_is_table_candidate(signal_t *sig)
+{
+	assert(sig);
+	if (sig->is_floating || sig->bit_length > 8)
+		return false;
+	return sig->scaling != 1.0 || sig->offset != 0.0;
+}
+
+/* The bytes of lookup table a signal needs, the bitset of valid raw values
+ * is only needed if some of them fail the range check */
+static size_t signal_table_cost(signal_t *sig, bool *all_valid)
+{
+	assert(sig);
+	assert(all_valid);
+	const unsigned entries = 1u << sig->bit_length;
+	raw_bounds_t b;
+	const bool check = signal_raw_bounds(sig, &b);
+	*all_valid = true;
+	for (unsigned i = 0; i < entries; i++) {
+		const uint64_t u = sig->is_signed ? (i + entries / 2) % entries : i;
+		*all_valid = *all_valid && (!check || (u >= b.lo && u <= b.hi));
+	}
+	return entries * sizeof(double) + (*all_valid ? 0 : (entries + 7) / 8);
+}
+
+/* Decode a small signal with one indexed load from a table of precomputed
+ * physical values, a bitset records which raw values pass the range check
+ * and is omitted when all of them do. The table is charged against the
+ * remaining byte 'budget', signals that do not fit use arithmetic. */
+static bool signal2decode_table(const char *source, signal_t *sig, FILE *o, size_t *budget)
+{
+	assert(source);
+	assert(sig);
+	assert(o);
+	assert(budget);
+	const unsigned entries = 1u << sig->bit_length;
+	raw_bounds_t b;
+	const bool check = signal_raw_bounds(sig, &b);
+	bool all_valid = true;
+	const size_t cost = signal_table_cost(sig, &all_valid);
+	if (cost > *budget)
+		return false;
+	*budget -= cost;
+
+	double value[256];
+	uint8_t valid[32] = {0};
+	for (unsigned i = 0; i < entries; i++) {
+		const uint64_t u = sig->is_signed ? (i + entries / 2) % entries : i;
+		value[i] = signal_raw2phys(sig, u);
+		if (!check || (u >= b.lo && u <= b.hi))
+			valid[i / 8] |= 1u << (i % 8);
+	}
+
+	fprintf(o, "	static const double table[%u] = {", entries);
+	for (unsigned i = 0; i < entries; i++)
+		fprintf(o, "%s%.17g,", i % 8 ? " " : "\n\t\t", value[i]);
+	fputs("\n\t};\n", o);
+	if (!all_valid) {
+		fprintf(o, "\tstatic const uint8_t valid[%u] = {", (entries + 7) / 8);
+		for (unsigned i = 0; i < (entries + 7) / 8; i++)
+			fprintf(o, "%s0x%02x,", i % 8 ? " " : "\n\t\t", valid[i]);
+		fputs("\n\t};\n", o);
+	}
+	fprintf(o, "\tconst unsigned i = (unsigned)(%s) & 0x%xu;\n", source, entries - 1);
+	if (!all_valid) {
+		fputs("\tif (!(valid[i >> 3] & (1u << (i & 7)))) {\n", o);
+		fputs("\t\t*out = (double)0;\n", o);
+		fputs("\t\treturn -1;\n", o);
+		fputs("\t}\n", o);
+	}
+	fputs("\t*out = table[i];\n", o);
+	fputs("\treturn 0;\n", o);
+	return true;
+}
+
+/* The name of a function decoding a raw value of a signal, or encoding into
+ * one, 'prefix' is "decode" or "encode" */
+static void signal_raw_name(const char *prefix, unsigned id, const char *name, char *fname, size_t maxlen, dbc2c_options_t *copts)
+{
+	assert(prefix);
+	assert(name);
+	assert(fname);
+	assert(copts);
+	if (copts->use_id_in_name)
+		snprintf(fname, maxlen - 1, "%s_raw_can_0x%03x_%s", prefix, id, name);
+	else
+		snprintf(fname, maxlen - 1, "%s_raw_can_%s", prefix, name);
+}
+
+/* The body of a decode function, converting the raw value 'source' */
+static int signal2decode_body(signal_t *sig, const char *source, const char *type, FILE *o, size_t *budget)
+{
+	assert(sig);
+	assert(source);
+	assert(type);
+	assert(o);
+	if (sig->scaling == 0.0)
+		error("invalid scaling factor (fix your DBC file)");
+	if (budget && signal_is_table_candidate(sig) && signal2decode_table(source, sig, o, budget))
+		return fputs("}\n\n", o);
+	raw_bounds_t b;
+	const bool check = signal_raw_bounds(sig, &b);
+	if (check) { /* reject out of range values before any floating point work */
+		char l[32] = {0}, h[32] = {0}, lo[64] = {0}, hi[64] = {0};
+		raw_literal(l, sizeof(l), sig, b.lo);
+		raw_literal(h, sizeof(h), sig, b.hi);
+		snprintf(lo, sizeof(lo) - 1, "(raw < %s)", l);
+		snprintf(hi, sizeof(hi) - 1, "(raw > %s)", h);
+		if (strcmp(source, "raw"))
+			fprintf(o, "\tconst %s raw = %s;\n", determine_type(sig->bit_length, sig->is_signed, false), source);
+		fprintf(o, "\tif (%s%s%s) {\n",
+				b.check_lo ? lo : "",
+				b.check_lo && b.check_hi ? " || " : "",
+				b.check_hi ? hi : "");
+		fprintf(o, "\t\t*out = (%s)0;\n", type);
+		fputs("\t\treturn -1;\n", o);
+		fputs("\t}\n", o);
+		fprintf(o, "\t%s rval = (%s)(raw);\n", type, type);
+	} else {
+		fprintf(o, "\t%s rval = (%s)(%s);\n", type, type, source);
+	}
+	if (sig->scaling != 1.0)
+		fprintf(o, "\trval *= %g;\n", sig->scaling);
+	if (sig->offset != 0.0)
+		fprintf(o, "\trval += %g;\n", sig->offset);
+	if (sig->is_floating && signal_are_min_max_valid(sig)) {
+		bool gmax = true;
+		bool gmin = true;
+
+		if (sig->is_signed) { /**@warning comparison may fail because of limits of double size */
+			gmin = sig->minimum > signed_min(sig);
+			gmax = sig->maximum < signed_max(sig);
+		} else {
+			gmin = sig->minimum > 0.0;
+			gmax = sig->maximum < unsigned_max(sig);
+		}
+		if (sig->is_floating)
+			gmax = true;
+
+		if (!gmax && !gmin) {
+			fputs("\t*out = rval;\n", o);
+			fputs("\treturn 0;\n", o);
+		} else {
+			if (gmin && gmax) {
+				fprintf(o, "\tif ((rval >= %g) && (rval <= %g)) {\n", sig->minimum, sig->maximum);
+			} else if (gmax) {
+				fprintf(o, "\tif (rval <= %g) {\n", sig->maximum);
+			} else if (gmin) {
+				fprintf(o, "\tif (rval >= %g) {\n", sig->minimum);
+			}
+			fputs("\t\t*out = rval;\n", o);
+			fputs("\t\treturn 0;\n", o);
+			fputs("\t} else {\n", o);
 			fprintf(o, "\t\t*out = (%s)0;\n", type);
 			fputs("\t\treturn -1;\n", o);
 			fputs("\t}\n", o);
@@ -433,22 +1126,64 @@ static int signal2scaling_decode(const char *msgname, unsigned id, signal_t *sig
 	return fputs("}\n\n", o);
 }
 
-static int signal2scaling(const char *msgname, unsigned id, signal_t *sig, FILE *o, bool decode, bool header, const char *god, dbc2c_options_t *copts)
+/* With 'raw' set the conversion is done by that function, taking the raw
+ * value, which group getters call as well. It is defined here if 'define'
+ * is set, otherwise it is shared with other messages (see '-d'). */
+static int signal2scaling_decode(const char *msgname, unsigned id, signal_t *sig, FILE *o, bool header, const char *god, size_t *budget, const signal_array_t *array, const char *raw, bool define, dbc2c_options_t *copts)
+{
+	assert(msgname);
+	assert(sig);
+	assert(o);
+	assert(copts);
+	const char *type = determine_type(sig->bit_length, sig->is_signed, sig->is_floating);
+	if (sig->scaling != 1.0 || sig->offset != 0.0)
+		type = "double";
+	const char *name = NULL, *index = NULL;
+	char field[MAX_NAME_LENGTH * 2] = {0}, source[MAX_NAME_LENGTH * 4] = {0};
+	signal_scaling_names(sig, array, &name, &index, field, sizeof(field));
+	snprintf(source, sizeof(source) - 1, "o->%s.%s", msgname, field);
+	if (raw && define && !header) {
+		fprintf(o, "static inline int %s(%s raw, %s *out) {\n", raw,
+				determine_type(sig->bit_length, sig->is_signed, sig->is_floating), copts->use_doubles_for_encoding ? "double" : type);
+		if (signal2decode_body(sig, "raw", type, o, budget) < 0)
+			return -1;
+	}
+	accessor_linkage(o, header, copts);
+	if (copts->use_id_in_name)
+		fprintf(o, "int decode_can_0x%03x_%s(const can_obj_%s_t *o%s, %s *out)", id, name, god, index, copts->use_doubles_for_encoding ? "double" : type);
+	else
+		fprintf(o, "int decode_can_%s(const can_obj_%s_t *o%s, %s *out)", name, god, index, copts->use_doubles_for_encoding ? "double" : type);
+	if (header)
+		return fputs(";\n", o);
+	fputs(" {\n", o);
+	if (copts->generate_asserts) {
+		fputs("\tassert(o);\n", o);
+		fputs("\tassert(out);\n", o);
+	}
+	if (array)
+		fprintf(o, "\tif (n >= %zu)\n\t\treturn -1;\n", array->count);
+	if (raw)
+		return fprintf(o, "\treturn %s(%s, out);\n}\n\n", raw, source);
+	return signal2decode_body(sig, source, type, o, budget);
+}
+
+static int signal2scaling(const char *msgname, unsigned id, signal_t *sig, FILE *o, bool decode, bool header, const char *god, size_t *budget, const signal_array_t *array, const char *raw, bool define, dbc2c_options_t *copts)
 {
 	assert(copts);
 	if (decode)
-		return signal2scaling_decode(msgname, id, sig, o, header, god, copts);
-	return signal2scaling_encode(msgname, id, sig, o, header, god, copts);
+		return signal2scaling_decode(msgname, id, sig, o, header, god, budget, array, raw, define, copts);
+	return signal2scaling_encode(msgname, id, sig, o, header, god, array, raw, copts);
 }
 
-static int print_function_name(FILE *out, const char *prefix, const char *name, const char *postfix, bool in, char *datatype, bool dlc, const char *god)
+static int print_function_name(FILE *out, const char *prefix, const char *name, const char *postfix, bool in, char *datatype, bool dlc, const char *god, bool external)
 {
 	assert(out);
 	assert(prefix);
 	assert(name);
 	assert(god);
 	assert(postfix);
-	return fprintf(out, "static int %s_%s(can_obj_%s_t *o, %s %sdata%s)%s",
+	return fprintf(out, "%sint %s_%s(can_obj_%s_t *o, %s %sdata%s)%s",
+			external ? "" : "static ",
 			prefix, name, god, datatype,
 			in ? "" : "*",
 			dlc ? ", uint8_t dlc, dbcc_time_stamp_t time_stamp" : "",
@@ -466,463 +1201,4494 @@ static void make_name(char *newname, size_t maxlen, const char *name, unsigned i
 		snprintf(newname, maxlen-1, "can_%s", name);
 }
 
-static signal_t *find_multiplexor(can_msg_t *msg) {
+/* With '-c' everything generated for a message is behind a switch,
+ * 'DBCC_<FILE>_MSG_<message>', named after the header file (the CAN object
+ * name without its "_h") so that codecs from different DBC files can be
+ * configured separately */
+static void switch_prefix(char *prefix, size_t maxlen, const char *god)
+{
+	assert(prefix);
+	assert(god);
+	size_t len = strlen(god);
+	if (len > 2 && !strcmp(god + len - 2, "_h"))
+		len -= 2;
+	snprintf(prefix, maxlen, "DBCC_%.*s", (int)len, god);
+	for (size_t i = 0; prefix[i]; i++)
+		prefix[i] = toupper(prefix[i]);
+}
+
+static void msg_switch_name(char *newname, size_t maxlen, can_msg_t *msg, const char *god, dbc2c_options_t *copts)
+{
+	assert(newname);
 	assert(msg);
-	signal_t *multiplexor = NULL;
-	for (size_t i = 0; i < msg->signal_count; i++) {
-		signal_t *sig = msg->sigs[i];
-		if (sig->is_multiplexor) {
-			if (multiplexor)
-				error("multiple multiplexor values detected (only one per CAN msg is allowed) for %s", msg->name);
-			multiplexor = sig;
-		}
-		if (sig->is_multiplexed)
-			continue;
-	}
-	return multiplexor;
+	assert(god);
+	assert(copts);
+	char prefix[MAX_NAME_LENGTH] = {0};
+	char name[MAX_NAME_LENGTH] = {0};
+	switch_prefix(prefix, sizeof(prefix), god);
+	make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+	snprintf(newname, maxlen, "%s_MSG_%s", prefix, name);
 }
 
-static signal_t *process_signals_and_find_multiplexer(can_msg_t *msg, FILE *c, const char *name, bool serialize)
+static void msg_switch_open(FILE *o, can_msg_t *msg, const char *god, dbc2c_options_t *copts)
 {
+	assert(o);
 	assert(msg);
-	assert(c);
-	assert(name);
-	signal_t *multiplexor = NULL;
+	assert(god);
+	assert(copts);
+	if (!copts->use_msg_switches)
+		return;
+	char sw[MAX_NAME_LENGTH * 2] = {0};
+	msg_switch_name(sw, sizeof(sw), msg, god, copts);
+	fprintf(o, "#if %s\n", sw);
+}
 
-	for (size_t i = 0; i < msg->signal_count; i++) {
-		signal_t *sig = msg->sigs[i];
-		if (sig->is_multiplexor) {
-			if (multiplexor)
-				error("multiple multiplexor values detected (only one per CAN msg is allowed) for %s", name);
-			multiplexor = sig;
-		}
-		if (sig->is_multiplexed)
+/* The structure and functions shared by messages with the same layout (see
+ * '-d') are needed if any one of them is switched on */
+static void layout_switch_open(FILE *o, dbc_t *dbc, can_msg_t *layout, const char *god, dbc2c_options_t *copts)
+{
+	assert(o);
+	assert(dbc);
+	assert(layout);
+	assert(god);
+	assert(copts);
+	if (!copts->use_msg_switches)
+		return;
+	fputs("#if", o);
+	for (size_t i = 0, n = 0; i < dbc->message_count; i++) {
+		if (dbc->messages[i]->layout != layout)
 			continue;
-		if ((serialize ? signal2serializer(sig, name, c, "\t") : signal2deserializer(sig, name, c, "\t")) < 0)
-			error("%s failed", serialize ? "serialization" : "deserialization");
+		char sw[MAX_NAME_LENGTH * 2] = {0};
+		msg_switch_name(sw, sizeof(sw), dbc->messages[i], god, copts);
+		fprintf(o, "%s%s", n++ ? " || " : " ", sw);
 	}
-	return multiplexor;
+	fputs("\n", o);
 }
 
-static int cmp_signal(const void *lhs, const void *rhs)
+static void msg_switch_close(FILE *o, dbc2c_options_t *copts)
 {
-	assert(lhs);
-	assert(rhs);
-	int ret = 0;
-	if ((*(signal_t**)lhs)->switchval < ((*(signal_t**)rhs)->switchval))
-		ret = -1;
-	else if ((*(signal_t**)lhs)->switchval > (*(signal_t**)rhs)->switchval)
-		ret = 1;
-	return ret;
+	assert(o);
+	assert(copts);
+	if (copts->use_msg_switches)
+		fputs("#endif\n", o);
 }
-static int multiplexor_switch(can_msg_t *msg, signal_t *multiplexor, FILE *c, const char *msg_name, bool serialize)
+
+/* Signals are accessed through 'record' followed by their field name, for
+ * the functions of a message it is the message within the CAN object, for
+ * functions shared between messages (see '-d') it is a local copy of it */
+static void msg_record(char *record, size_t maxlen, const char *name)
 {
-	assert(msg);
-	assert(multiplexor);
-	assert(c);
-	fprintf(c, "\tswitch (o->%s.%s) {\n", msg_name, multiplexor->name);
-	qsort(msg->sigs, msg->signal_count, sizeof(*msg->sigs), cmp_signal);
-	for (size_t i = 0; i < msg->signal_count; i++) {
-		signal_t *sig = msg->sigs[i];
-		if (!(sig->is_multiplexed))
-			continue;
-		fprintf(c, "\tcase %u:\n", sig->switchval);
-		size_t j = i;
-		for (; j < msg->signal_count && msg->sigs[i]->switchval == msg->sigs[j]->switchval; j++) {
-			assert(j < msg->signal_count);
-			signal_t* sig = msg->sigs[j];
-			if ((serialize ? signal2serializer(sig, msg_name, c, "\t\t") : signal2deserializer(sig, msg_name, c, "\t\t")) < 0)
-				return -1;
-		}
-		i = j - 1;
-		assert(i < msg->signal_count);
-		fprintf(c, "\t\tbreak;\n");
-	}
-	fprintf(c, "\tdefault:\n\t\treturn -1;\n\t}\n");
-	return 0;
+	assert(record);
+	assert(name);
+	snprintf(record, maxlen, "o->%s.", name);
 }
 
-static int msg_data_type(FILE *c, can_msg_t *msg, bool data, dbc2c_options_t *copts)
+static bool signal_is_received_by(signal_t *sig, const char *node)
+{
+	assert(sig);
+	assert(node);
+	for (size_t i = 0; i < sig->ecu_count; i++)
+		if (!strcmp(sig->ecus[i], node))
+			return true;
+	return false;
+}
+
+/* If no node is given then code is generated for all messages, as if we
+ * were every node on the bus */
+static bool msg_is_tx(can_msg_t *msg, dbc2c_options_t *copts)
 {
-	assert(c);
 	assert(msg);
 	assert(copts);
-	char name[MAX_NAME_LENGTH] = {0};
-	make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
-	return fprintf(c, "\t%s_t %s%s;\n", name, name, data ? "_data" : "");
+	if (!copts->node)
+		return true;
+	return msg->ecu && !strcmp(msg->ecu, copts->node);
 }
 
-
-static int msg_data_type_bitfields(FILE *c, can_msg_t *msg, dbc2c_options_t *copts) {
-	assert(c);
+static bool msg_is_rx(can_msg_t *msg, dbc2c_options_t *copts)
+{
 	assert(msg);
 	assert(copts);
-	char name[MAX_NAME_LENGTH] = {0};
-	make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
-	fprintf(c, "\tunsigned %s_status : 2;\n", name); /* uninitialized, present, faulty (range/crc/timeout/other) */
-	fprintf(c, "\tunsigned %s_tx : 1;\n", name); /* have we packed this message? */
-	return fprintf(c, "\tunsigned %s_rx : 1;\n", name); /* have we unpacked this message? */
+	if (!copts->node)
+		return true;
+	for (size_t i = 0; i < msg->signal_count; i++)
+		if (signal_is_received_by(msg->sigs[i], copts->node))
+			return true;
+	return false;
 }
 
-static int msg_data_type_time_stamp(FILE *c, can_msg_t *msg, dbc2c_options_t *copts) {
-	assert(c);
-	assert(msg);
+static bool msg_generate_pack(can_msg_t *msg, dbc2c_options_t *copts)
+{
 	assert(copts);
-	char name[MAX_NAME_LENGTH] = {0};
-	make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
-	return fprintf(c, "\tdbcc_time_stamp_t %s_time_stamp_rx;\n", name);
+	return copts->generate_pack && msg_is_tx(msg, copts);
 }
 
-static int msg_pack(can_msg_t *msg, FILE *c, const char *name, bool motorola_used, bool intel_used, const char *god, dbc2c_options_t *copts)
+static bool msg_generate_unpack(can_msg_t *msg, dbc2c_options_t *copts)
 {
-	assert(msg);
-	assert(c);
-	assert(name);
 	assert(copts);
-	const bool message_has_signals = motorola_used || intel_used;
-	print_function_name(c, "pack", name, " {\n", false, "uint64_t", false, god);
-	if (copts->generate_asserts) {
-		fprintf(c, "\tassert(o);\n");
-		fprintf(c, "\tassert(data);\n");
+	return copts->generate_unpack && msg_is_rx(msg, copts);
+}
+
+/* The top level multiplexor; with extended multiplexing there may be more
+ * multiplexors, but those are themselves multiplexed ('m<N>M') */
+static signal_t *find_multiplexor(can_msg_t *msg) {
+	assert(msg);
+	signal_t *multiplexor = NULL;
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		signal_t *sig = msg->sigs[i];
+		if (sig->is_multiplexed)
+			continue;
+		if (sig->is_multiplexor) {
+			if (multiplexor)
+				error("multiple multiplexor values detected (only one per CAN msg is allowed) for %s", msg->name);
+			multiplexor = sig;
+		}
 	}
-	if (message_has_signals)
-		fprintf(c, "\tregister uint64_t x;\n");
-	if (motorola_used)
-		fprintf(c, "\tregister uint64_t m = 0;\n");
-	if (intel_used)
-		fprintf(c, "\tregister uint64_t i = 0;\n");
-	if (!message_has_signals)
-		fprintf(c, "\tUNUSED(o);\n\tUNUSED(data);\n");
-	signal_t *multiplexor = process_signals_and_find_multiplexer(msg, c, name, true);
+	return multiplexor;
+}
 
-	if (multiplexor)
-		if (multiplexor_switch(msg, multiplexor, c, name, true) < 0)
-			return -1;
+/* The multiplexor selecting a multiplexed signal, either the one given by
+ * SG_MUL_VAL_ or the top level one */
+static signal_t *signal_multiplexor(can_msg_t *msg, signal_t *sig)
+{
+	assert(msg);
+	assert(sig);
+	if (!sig->is_multiplexed)
+		return NULL;
+	if (!sig->multiplexor_name)
+		return find_multiplexor(msg);
+	for (size_t i = 0; i < msg->signal_count; i++)
+		if (msg->sigs[i]->is_multiplexor && !strcmp(msg->sigs[i]->name, sig->multiplexor_name))
+			return msg->sigs[i];
+	return NULL;
+}
 
-	if (message_has_signals) {
-		fprintf(c, "\t*data = %s%s%s%s%s;\n",
-			swap_motorola && motorola_used ? "reverse_byte_order" : "",
-			motorola_used ? "(m)" : "",
-			motorola_used && intel_used ? "|" : "",
-			(!swap_motorola && intel_used) ? "reverse_byte_order" : "",
-			intel_used ? "(i)" : "");
-	}
-	fprintf(c, "\to->%s_tx = 1;\n", name);
-	fprintf(c, "\treturn 0;\n}\n\n");
-	return 0;
+static bool signal_selected_by(signal_t *sig, unsigned value)
+{
+	assert(sig);
+	for (size_t i = 0; i < sig->mux_range_count; i++)
+		if (value >= sig->mux_ranges[i].lo && value <= sig->mux_ranges[i].hi)
+			return true;
+	return false;
 }
 
-static int msg_unpack(can_msg_t *msg, FILE *c, const char *name, bool motorola_used, bool intel_used, const char *god, dbc2c_options_t *copts)
+/* A signal selected by a single value of the top level multiplexor, as
+ * opposed to one using extended multiplexing */
+static bool signal_is_simple_multiplexed(can_msg_t *msg, signal_t *sig)
 {
 	assert(msg);
-	assert(c);
-	assert(name);
-	assert(copts);
-	const bool message_has_signals = motorola_used || intel_used;
-	print_function_name(c, "unpack", name, " {\n", true, "uint64_t", true, god);
-	if (copts->generate_asserts) {
-		fprintf(c, "\tassert(o);\n");
-		fprintf(c, "\tassert(dlc <= 8);\n");
-	}
-	if (message_has_signals)
-		fprintf(c, "\tregister uint64_t x;\n");
-	if (motorola_used)
-		fprintf(c, "\tregister uint64_t m = %s(data);\n", swap_motorola ? "reverse_byte_order" : "");
-	if (intel_used)
-		fprintf(c, "\tregister uint64_t i = %s(data);\n", swap_motorola ? "" : "reverse_byte_order");
-	if (!message_has_signals)
-		fprintf(c, "\tUNUSED(o);\n\tUNUSED(data);\n");
-	if (msg->dlc)
-		fprintf(c, "\tif (dlc < %u)\n\t\treturn -1;\n", msg->dlc);
-	else
-		fprintf(c, "\tUNUSED(dlc);\n");
-
-	signal_t *multiplexor = process_signals_and_find_multiplexer(msg, c, name, false);
-	if (multiplexor)
-		if (multiplexor_switch(msg, multiplexor, c, name, false) < 0)
-			return -1;
-	fprintf(c, "\to->%s_rx = 1;\n", name);
-	fprintf(c, "\to->%s_time_stamp_rx = time_stamp;\n", name);
-	fprintf(c, "\treturn 0;\n}\n\n");
-	return 0;
+	assert(sig);
+	return sig->is_multiplexed
+		&& sig->mux_range_count == 1
+		&& sig->mux_ranges[0].lo == sig->mux_ranges[0].hi
+		&& signal_multiplexor(msg, sig) == find_multiplexor(msg);
 }
 
-static int msg_print(can_msg_t *msg, FILE *c, const char *name, const char *god, dbc2c_options_t *copts)
+/* can both multiplexed signals be in the same frame? */
+static bool signal_multiplexed_together(can_msg_t *msg, signal_t *a, signal_t *b)
 {
 	assert(msg);
+	assert(a);
+	assert(b);
+	if (signal_multiplexor(msg, a) != signal_multiplexor(msg, b))
+		return false;
+	for (size_t i = 0; i < a->mux_range_count; i++)
+		for (size_t j = 0; j < b->mux_range_count; j++)
+			if (a->mux_ranges[i].lo <= b->mux_ranges[j].hi && b->mux_ranges[j].lo <= a->mux_ranges[i].hi)
+				return true;
+	return false;
+}
+
+/* Print a C expression that is true when a multiplexor is within lo to hi,
+ * comparisons that are always true for its type are left out. Two
+ * comparisons are put in parentheses if 'group' is set. */
+static int mux_interval2c(const char *record, signal_t *multiplexor, uint64_t lo, uint64_t hi, bool group, FILE *o)
+{
+	assert(record);
+	assert(multiplexor);
+	assert(o);
+	const uint64_t max = multiplexor->bit_length >= 64 ? UINT64_MAX : (1uLL << multiplexor->bit_length) - 1uLL;
+	const bool lower = lo > 0, upper = hi < max;
+	if (lo == hi)
+		return fprintf(o, "%s%s == %"PRIu64, record, multiplexor->name, lo);
+	if (lower && upper)
+		return fprintf(o, "%s%s%s >= %"PRIu64" && %s%s <= %"PRIu64"%s", group ? "(" : "",
+				record, multiplexor->name, lo, record, multiplexor->name, hi, group ? ")" : "");
+	if (lower)
+		return fprintf(o, "%s%s >= %"PRIu64, record, multiplexor->name, lo);
+	if (upper)
+		return fprintf(o, "%s%s <= %"PRIu64, record, multiplexor->name, hi);
+	return fputs("1", o);
+}
+
+/* Print a C expression that is true when a multiplexed signal is in the
+ * frame, including the conditions on the multiplexors above it */
+static int signal_active2c(can_msg_t *msg, signal_t *sig, const char *record, FILE *o, size_t depth)
+{
+	assert(msg);
+	assert(sig);
+	assert(record);
+	assert(o);
+	signal_t *multiplexor = signal_multiplexor(msg, sig);
+	if (!multiplexor)
+		return fputs("1", o);
+	if (depth > msg->signal_count)
+		error("multiplexors of %s select each other", msg->name);
+	if (multiplexor->is_multiplexed) {
+		fputc('(', o);
+		signal_active2c(msg, multiplexor, record, o, depth + 1);
+		fputs(") && ", o);
+	}
+	const bool several = sig->mux_range_count > 1;
+	if (several)
+		fputc('(', o);
+	for (size_t i = 0; i < sig->mux_range_count; i++) {
+		if (i)
+			fputs(" || ", o);
+		mux_interval2c(record, multiplexor, sig->mux_ranges[i].lo, sig->mux_ranges[i].hi, true, o);
+	}
+	if (several)
+		fputc(')', o);
+	return 0;
+}
+
+static int signal_array2type(const signal_array_t *a, FILE *o)
+{
+	assert(a);
+	assert(o);
+	signal_t *sig = a->elements[0];
+	return fprintf(o, "\t%s %s[%zu]; /* scaling %g, offset %g, units %s, %s to %s */\n",
+			determine_type(sig->bit_length, sig->is_signed, false), a->name, a->count,
+			sig->scaling, sig->offset, sig->units[0] ? sig->units : "none",
+			sig->name, a->elements[a->count - 1]->name);
+}
+
+/* Bits of the frame a signal occupies, Motorola signals count down within a
+ * byte and then continue from the top of the next byte. */
+static uint64_t signal_occupancy(signal_t *sig)
+{
+	assert(sig);
+	uint64_t bits = 0;
+	unsigned pos = sig->start_bit;
+	for (unsigned k = 0; k < sig->bit_length && pos < 64; k++) {
+		bits |= 1uLL << pos;
+		if (sig->endianess == endianess_motorola_e)
+			pos = (pos % 8) ? pos - 1 : pos + 15;
+		else
+			pos++;
+	}
+	return bits;
+}
+
+static int msg_overlap_check(can_msg_t *msg)
+{
+	assert(msg);
+	uint64_t common = 0;
+	int r = 0;
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		signal_t *sig = msg->sigs[i];
+		if (sig->is_multiplexed)
+			continue;
+		const uint64_t bits = signal_occupancy(sig);
+		if (common & bits) {
+			warning("Signal %s overlaps another signal in %s (fix your DBC file)", sig->name, msg->name);
+			r = -1;
+		}
+		common |= bits;
+	}
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		signal_t *sig = msg->sigs[i];
+		if (!(sig->is_multiplexed))
+			continue;
+		const uint64_t bits = signal_occupancy(sig);
+		bool overlaps = !!(common & bits);
+		for (size_t j = 0; j < i; j++) {
+			signal_t *other = msg->sigs[j];
+			if (other->is_multiplexed && signal_multiplexed_together(msg, other, sig))
+				overlaps = overlaps || (signal_occupancy(other) & bits);
+		}
+		if (overlaps) {
+			warning("Signal %s overlaps another signal in %s (fix your DBC file)", sig->name, msg->name);
+			r = -1;
+		}
+	}
+	return r;
+}
+
+typedef struct {
+	unsigned long number;
+	signal_t *sig;
+} numbered_signal_t;
+
+/* Split a signal name into an array name and the number ending it, an
+ * underscore before the number is dropped from the array name. */
+static bool signal_array_name(signal_t *sig, char *name, size_t maxlen, unsigned long *number)
+{
+	assert(sig);
+	assert(name);
+	assert(number);
+	const size_t l = strlen(sig->name);
+	size_t p = l;
+	while (p && isdigit((unsigned char)sig->name[p - 1]))
+		p--;
+	if (p == 0 || p == l || (l - p) > 9 || p >= maxlen)
+		return false;
+	memcpy(name, sig->name, p);
+	name[p] = '\0';
+	if (p > 1 && name[p - 1] == '_')
+		name[p - 1] = '\0';
+	*number = strtoul(sig->name + p, NULL, 10);
+	return true;
+}
+
+static bool signal_array_compatible(signal_t *a, signal_t *b)
+{
+	assert(a);
+	assert(b);
+	return a->bit_length == b->bit_length
+		&& a->is_signed == b->is_signed
+		&& !(a->is_floating || b->is_floating)
+		&& !(a->is_multiplexor || b->is_multiplexor)
+		&& a->is_multiplexed == b->is_multiplexed
+		&& !(a->multiplexor_name || b->multiplexor_name)
+		&& signal_is_swapped(a) == signal_is_swapped(b)
+		&& a->scaling == b->scaling
+		&& a->offset == b->offset
+		&& a->minimum == b->minimum
+		&& a->maximum == b->maximum
+		&& a->val_list == b->val_list
+		&& !strcmp(a->units, b->units);
+}
+
+static int numbered_signal_compare(const void *a, const void *b)
+{
+	const numbered_signal_t *x = a, *y = b;
+	if (x->number < y->number) return -1;
+	if (x->number > y->number) return  1;
+	return 0;
+}
+
+/* Check the elements (sorted by number) form a loop: their numbers count up
+ * in equal steps, each page holds the same number of elements at the same
+ * shifts, equally spaced, and the pages follow the multiplexor values. */
+static bool signal_array_layout(can_msg_t *msg, numbered_signal_t *n, size_t count, signal_array_t *a)
+{
+	assert(msg);
+	assert(n);
+	assert(a);
+	const unsigned swap = msg_swap_width(msg);
+	const unsigned long step = n[1].number - n[0].number;
+	signal_t *first = n[0].sig;
+	size_t page = count;
+	if (first->is_multiplexed)
+		for (page = 1; page < count && n[page].sig->switchval == first->switchval;)
+			page++;
+	if (count % page)
+		return false;
+	a->page = page;
+	a->shift = signal_shift(first, swap);
+	a->stride = page > 1 ? (int)signal_shift(n[1].sig, swap) - (int)a->shift : 0;
+	a->switchval = first->switchval;
+	if (page > 1 && (unsigned)abs(a->stride) < first->bit_length)
+		return false;
+	for (size_t j = 0; j < count; j++) {
+		signal_t *sig = n[j].sig;
+		if (step == 0 || (j && (n[j].number - n[j - 1].number) != step))
+			return false;
+		if ((int)signal_shift(sig, swap) != (int)a->shift + (int)(j % page) * a->stride)
+			return false;
+		if (sig->is_multiplexed && sig->switchval != first->switchval + (j / page))
+			return false;
+	}
+	return true;
+}
+
+/* Find the array 'sig' is an element of by looking at every other signal of
+ * the message, the elements of 'a' must be released with free. */
+static bool signal_array_find(can_msg_t *msg, signal_t *sig, signal_array_t *a)
+{
+	assert(msg);
+	assert(sig);
+	assert(a);
+	memset(a, 0, sizeof(*a));
+	unsigned long number = 0;
+	if (!signal_array_name(sig, a->name, sizeof(a->name), &number))
+		return false;
+	numbered_signal_t *n = allocate(sizeof(*n) * (msg->signal_count + 1));
+	size_t count = 0;
+	bool ok = true;
+	for (size_t i = 0; i < msg->signal_count && ok; i++) {
+		signal_t *other = msg->sigs[i];
+		char name[MAX_NAME_LENGTH] = {0};
+		unsigned long num = 0;
+		if (!strcmp(other->name, a->name))
+			ok = false; /* a signal already has the name of the array */
+		if (!signal_array_name(other, name, sizeof(name), &num) || strcmp(name, a->name))
+			continue;
+		if (strspn(other->name + strlen(name), "_") != strspn(sig->name + strlen(name), "_"))
+			ok = false; /* "Cell_V_1" and "Cell_V1" would both become "Cell_V" */
+		if (!signal_array_compatible(sig, other))
+			ok = false;
+		n[count].number = num;
+		n[count++].sig = other;
+	}
+	if (ok && count >= ARRAY_MIN_ELEMENTS) {
+		qsort(n, count, sizeof(*n), numbered_signal_compare);
+		ok = signal_array_layout(msg, n, count, a);
+	} else {
+		ok = false;
+	}
+	if (ok) {
+		a->count = count;
+		a->elements = allocate(sizeof(*a->elements) * count);
+		for (size_t j = 0; j < count; j++)
+			a->elements[j] = n[j].sig;
+	}
+	free(n);
+	return ok;
+}
+
+/* Look up the array 'sig' is an element of, and its index, the first time
+ * this is asked for a message all of its arrays are found */
+static const signal_array_t *signal_array(can_msg_t *msg, signal_t *sig, dbc2c_options_t *copts, size_t *index)
+{
+	assert(msg);
+	assert(sig);
+	assert(copts);
+	if (!(copts->use_arrays))
+		return NULL;
+	if (!(msg->arrays_found)) {
+		msg->arrays_found = true;
+		for (size_t i = 0; i < msg->signal_count; i++) {
+			if (signal_array(msg, msg->sigs[i], copts, NULL))
+				continue;
+			signal_array_t a;
+			if (!signal_array_find(msg, msg->sigs[i], &a))
+				continue;
+			msg->arrays = reallocator(msg->arrays, sizeof(*msg->arrays) * (msg->array_count + 1));
+			msg->arrays[msg->array_count++] = a;
+		}
+	}
+	for (size_t i = 0; i < msg->array_count; i++)
+		for (size_t j = 0; j < msg->arrays[i].count; j++)
+			if (msg->arrays[i].elements[j] == sig) {
+				if (index)
+					*index = j;
+				return &msg->arrays[i];
+			}
+	return NULL;
+}
+
+static void dbc_arrays_free(dbc_t *dbc)
+{
+	assert(dbc);
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = dbc->messages[i];
+		for (size_t j = 0; j < msg->array_count; j++)
+			free(msg->arrays[j].elements);
+		free(msg->arrays);
+		msg->arrays = NULL;
+		msg->array_count = 0;
+		msg->arrays_found = false;
+	}
+}
+
+static bool signal_in_array(can_msg_t *msg, signal_t *sig, dbc2c_options_t *copts)
+{
+	return signal_array(msg, sig, copts, NULL) != NULL;
+}
+
+static bool msg_has_arrays(can_msg_t *msg, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(copts);
+	for (size_t i = 0; copts->use_arrays && i < msg->signal_count; i++)
+		if (signal_in_array(msg, msg->sigs[i], copts))
+			return true;
+	return false;
+}
+
+/* Only the multiplexed signals selected by the current multiplexor value
+ * hold anything, so they can share storage; each multiplexor value gets a
+ * structure within an anonymous union, the multiplexor itself is the tag.
+ * Array elements span several multiplexor values and are kept out of it. */
+static bool signal_in_union(can_msg_t *msg, signal_t *sig, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(sig);
+	assert(copts);
+	return copts->use_unions && signal_is_simple_multiplexed(msg, sig) && !signal_in_array(msg, sig, copts);
+}
+
+static int signal_branch_compare(const void *a, const void *b)
+{
+	assert(a);
+	assert(b);
+	signal_t *ap = *((signal_t**)a);
+	signal_t *bp = *((signal_t**)b);
+	if (ap->switchval < bp->switchval) return -1;
+	if (ap->switchval > bp->switchval) return  1;
+	if (ap->bit_length > bp->bit_length) return -1;
+	if (ap->bit_length < bp->bit_length) return  1;
+	if (ap->start_bit < bp->start_bit) return -1;
+	if (ap->start_bit > bp->start_bit) return  1;
+	return 0;
+}
+
+/* the signals in the union sorted by multiplexor value and then by size,
+ * the caller frees the returned list */
+static signal_t **msg_union_signals(can_msg_t *msg, dbc2c_options_t *copts, size_t *count)
+{
+	assert(msg);
+	assert(copts);
+	assert(count);
+	signal_t **sigs = allocate((msg->signal_count + 1) * sizeof(*sigs));
+	*count = 0;
+	for (size_t i = 0; i < msg->signal_count; i++)
+		if (signal_in_union(msg, msg->sigs[i], copts))
+			sigs[(*count)++] = msg->sigs[i];
+	qsort(sigs, *count, sizeof(*sigs), signal_branch_compare);
+	return sigs;
+}
+
+static int msg2h_union(can_msg_t *msg, FILE *h, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(h);
+	assert(copts);
+	size_t count = 0;
+	signal_t **sigs = msg_union_signals(msg, copts, &count);
+	signal_t *multiplexor = find_multiplexor(msg);
+	int r = 0;
+	if (!count)
+		goto out;
+	fprintf(h, "\tDBCC_ANONYMOUS union { /* tagged by %s */\n", multiplexor->name);
+	for (size_t i = 0; i < count; i++) {
+		if (!i || sigs[i]->switchval != sigs[i - 1]->switchval)
+			fprintf(h, "\t\tstruct { /* %s == %u */\n", multiplexor->name, sigs[i]->switchval);
+		if (signal2type(sigs[i], h, "\t\t\t") < 0) {
+			r = -1;
+			goto out;
+		}
+		if ((i + 1) == count || sigs[i + 1]->switchval != sigs[i]->switchval)
+			fputs("\t\t};\n", h);
+	}
+	fputs("\t};\n", h);
+out:
+	free(sigs);
+	return r;
+}
+
+/* How a signal is accessed within its message structure */
+static void signal_field(can_msg_t *msg, signal_t *sig, dbc2c_options_t *copts, char *field, size_t maxlen)
+{
+	assert(field);
+	size_t index = 0;
+	const signal_array_t *a = signal_array(msg, sig, copts, &index);
+	if (a)
+		snprintf(field, maxlen - 1, "%s[%zu]", a->name, index);
+	else
+		snprintf(field, maxlen - 1, "%s", sig->name);
+}
+
+/* Move the elements of an array in or out of the frame in a loop, for a
+ * multiplexed array only the page the multiplexor selects. */
+static int signal_array2loop(const signal_array_t *a, const char *record, signal_t *multiplexor, bool serialize, FILE *o)
+{
+	assert(a);
+	assert(record);
+	assert(o);
+	signal_t *sig = a->elements[0];
+	const unsigned length = sig->bit_length;
+	const uint64_t mask = length == 64 ?
+		0xFFFFFFFFFFFFFFFFuLL :
+		(1uLL << length) - 1uLL;
+	const char *indent = "\t\t";
+	char slot[MAX_NAME_LENGTH] = "k", shift[64] = {0};
+	if (a->stride)
+		snprintf(shift, sizeof(shift) - 1, "(%u %c k * %u)", a->shift, a->stride < 0 ? '-' : '+', (unsigned)abs(a->stride));
+	else
+		snprintf(shift, sizeof(shift) - 1, "%u", a->shift);
+
+	fprintf(o, "\t/* %s: %zu x %u bits, scaling %g, offset %g */\n", a->name, a->count, length, sig->scaling, sig->offset);
+	if (multiplexor) {
+		const unsigned last = a->switchval + (unsigned)(a->count / a->page) - 1u;
+		if (a->switchval) {
+			fprintf(o, "\tif ((%s%s >= %u) && (%s%s <= %u)) {\n", record, multiplexor->name, a->switchval, record, multiplexor->name, last);
+			fprintf(o, "\t\tconst unsigned base = (unsigned)(%s%s - %u) * %zuu;\n", record, multiplexor->name, a->switchval, a->page);
+		} else {
+			fprintf(o, "\tif (%s%s <= %u) {\n", record, multiplexor->name, last);
+			fprintf(o, "\t\tconst unsigned base = (unsigned)(%s%s) * %zuu;\n", record, multiplexor->name, a->page);
+		}
+		snprintf(slot, sizeof(slot) - 1, "base + k");
+		indent = "\t\t\t";
+	}
+	fprintf(o, "%.*sfor (unsigned k = 0; k < %zu; k++) {\n", (int)strlen(indent) - 1, indent, a->page);
+	if (serialize) {
+		fprintf(o, "%sx = ((%s)(%s%s[%s])) & 0x%"PRIx64";\n", indent, determine_unsigned_type(length), record, a->name, slot, mask);
+		if (a->stride || a->shift)
+			fprintf(o, "%sx <<= %s;\n", indent, shift);
+		fprintf(o, "%s%c |= x;\n", indent, signal_is_swapped(sig) ? 'm' : 'i');
+	} else {
+		if (a->stride || a->shift)
+			fprintf(o, "%sx = (%c >> %s) & 0x%"PRIx64";\n", indent, signal_is_swapped(sig) ? 'm' : 'i', shift, mask);
+		else
+			fprintf(o, "%sx = %c & 0x%"PRIx64";\n", indent, signal_is_swapped(sig) ? 'm' : 'i', mask);
+		signal_sign_extend(sig, o, indent);
+		fprintf(o, "%s%s%s[%s] = x;\n", indent, record, a->name, slot);
+	}
+	fprintf(o, "%.*s}\n", (int)strlen(indent) - 1, indent);
+	if (multiplexor)
+		fputs("\t}\n", o);
+	return 0;
+}
+
+static bool signal_is_overlay_candidate(signal_t *sig)
+{
+	assert(sig);
+	const unsigned l = sig->bit_length;
+	return sig->endianess == endianess_intel_e
+		&& !(sig->is_floating)
+		&& !(sig->is_multiplexed)
+		&& !(sig->is_multiplexor)
+		&& (sig->start_bit % 8) == 0
+		&& (l == 8 || l == 16 || l == 32 || l == 64)
+		&& (sig->start_bit + l) <= 64;
+}
+
+/* Number of signals from sigs[i] onwards that can be copied straight between
+ * the frame and the message structure on a little endian host; Intel integer
+ * signals that follow each other in the frame and in the structure. As the
+ * structure is sorted by size, or laid out in frame order when that has no
+ * padding (see msg_wire_layout), there is normally no padding between them,
+ * this is checked at compile time. A run of one is not worth it, without
+ * '-O' every run is one. */
+static size_t signal_run_length(can_msg_t *msg, size_t i, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(copts);
+	assert(i < msg->signal_count);
+	signal_t *first = msg->sigs[i];
+	if (!(copts->use_overlay) || !signal_is_overlay_candidate(first) || find_multiplexor(msg) || signal_in_array(msg, first, copts))
+		return 1;
+	size_t n = 1;
+	for (size_t j = i + 1; j < msg->signal_count; j++, n++) {
+		signal_t *prev = msg->sigs[j - 1], *sig = msg->sigs[j];
+		if (!signal_is_overlay_candidate(sig) || signal_in_array(msg, sig, copts))
+			break;
+		if (sig->start_bit != (prev->start_bit + prev->bit_length))
+			break;
+	}
+	return n;
+}
+
+/* number of signals in a message covered by runs */
+static size_t msg_overlay_signals(can_msg_t *msg, dbc2c_options_t *copts)
+{
+	assert(msg);
+	size_t covered = 0;
+	for (size_t i = 0; i < msg->signal_count;) {
+		const size_t n = signal_run_length(msg, i, copts);
+		covered += n > 1 ? n : 0;
+		i += n;
+	}
+	return covered;
+}
+
+static bool msg_overlay_complete(can_msg_t *msg, dbc2c_options_t *copts)
+{
+	assert(msg);
+	return msg->signal_count && msg_overlay_signals(msg, copts) == msg->signal_count;
+}
+
+static bool dbc_uses_overlay(dbc_t *dbc, dbc2c_options_t *copts)
+{
+	assert(dbc);
+	assert(copts);
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = dbc->messages[i];
+		if (!msg_generate_pack(msg, copts) && !msg_generate_unpack(msg, copts))
+			continue;
+		if (msg_overlay_signals(msg, copts))
+			return true;
+	}
+	return false;
+}
+
+static int msg_overlay_asserts(can_msg_t *msg, FILE *c, const char *name, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(c);
+	assert(name);
+	if (!msg_overlay_signals(msg, copts))
+		return 0;
+	fputs("#ifdef DBCC_LITTLE_ENDIAN\n", c);
+	for (size_t i = 0; i < msg->signal_count;) {
+		const size_t n = signal_run_length(msg, i, copts);
+		signal_t *first = msg->sigs[i], *last = msg->sigs[i + n - 1];
+		if (n > 1)
+			fprintf(c, "DBCC_STATIC_ASSERT((offsetof(%s_t, %s) - offsetof(%s_t, %s)) == %u, %s_%s_overlay);\n",
+				name, last->name, name, first->name, (last->start_bit - first->start_bit) / 8, name, first->name);
+		i += n;
+	}
+	return fputs("#endif\n\n", c);
+}
+
+static int signal_run2overlay(can_msg_t *msg, size_t i, size_t n, FILE *c, const char *record, bool serialize, extract_e extract)
+{
+	assert(msg);
+	assert(c);
+	assert(record);
+	assert((i + n) <= msg->signal_count);
+	signal_t *first = msg->sigs[i], *last = msg->sigs[i + n - 1];
+	const unsigned offset = first->start_bit / 8, bytes = (last->start_bit + last->bit_length - first->start_bit) / 8;
+	const unsigned swap = msg_swap_width(msg);
+	fputs("#ifdef DBCC_LITTLE_ENDIAN\n", c);
+	if (serialize) {
+		fputs("\t{\n\t\tuint64_t w = 0;\n", c);
+		fprintf(c, "\t\tmemcpy((unsigned char *)&w + %u, &%s%s, %u); /* %s to %s */\n", offset, record, first->name, bytes, first->name, last->name);
+		if (extract == EXTRACT_WORDS_E)
+			fputs("\t\ti0 |= (uint32_t)w;\n\t\ti1 |= (uint32_t)(w >> 32);\n\t}\n", c);
+		else
+			fputs("\t\ti |= w;\n\t}\n", c);
+	} else {
+		fprintf(c, "\tmemcpy(&%s%s, (const unsigned char *)&data + %u, %u); /* %s to %s */\n", record, first->name, offset, bytes, first->name, last->name);
+	}
+	fputs("#else\n", c);
+	for (size_t j = i; j < i + n; j++)
+		if ((serialize ? signal2serializer(msg->sigs[j], record, swap, extract, c, "\t") : signal2deserializer(msg->sigs[j], record, swap, extract, c, "\t")) < 0)
+			return -1;
+	return fputs("#endif\n", c);
+}
+
+static signal_t *process_signals_and_find_multiplexer(can_msg_t *msg, FILE *c, const char *record, bool serialize, extract_e extract, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(c);
+	assert(record);
+	signal_t *multiplexor = NULL;
+	const unsigned swap = msg_swap_width(msg);
+
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		signal_t *sig = msg->sigs[i];
+		if (sig->is_multiplexor && !sig->is_multiplexed) {
+			if (multiplexor)
+				error("multiple multiplexor values detected (only one per CAN msg is allowed) for %s", msg->name);
+			multiplexor = sig;
+		}
+		if (sig->is_multiplexed)
+			continue;
+		size_t index = 0;
+		const signal_array_t *a = signal_array(msg, sig, copts, &index);
+		if (a) {
+			if (index == 0 && signal_array2loop(a, record, NULL, serialize, c) < 0)
+				error("%s failed", serialize ? "serialization" : "deserialization");
+			continue;
+		}
+		const size_t run = signal_run_length(msg, i, copts);
+		if (run > 1) {
+			if (signal_run2overlay(msg, i, run, c, record, serialize, extract) < 0)
+				error("%s failed", serialize ? "serialization" : "deserialization");
+			i += run - 1;
+			continue;
+		}
+		if ((serialize ? signal2serializer(sig, record, swap, extract, c, "\t") : signal2deserializer(sig, record, swap, extract, c, "\t")) < 0)
+			error("%s failed", serialize ? "serialization" : "deserialization");
+	}
+	return multiplexor;
+}
+
+/* Indentation for nested multiplexors */
+static const char *tabs(unsigned n)
+{
+	static const char t[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+	return t + sizeof(t) - 1 - (n < (sizeof(t) - 1) ? n : (sizeof(t) - 1));
+}
+
+/* Multiplexor values lo to hi select the same signals as those of the
+ * interval at index 'group' */
+typedef struct {
+	uint64_t lo, hi;
+	size_t group;
+} mux_interval_t;
+
+static int uint64_compare(const void *a, const void *b)
+{
+	assert(a);
+	assert(b);
+	const uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static int multiplexor_dispatch(can_msg_t *msg, signal_t *multiplexor, FILE *c, const char *record, bool serialize, extract_e extract, dbc2c_options_t *copts, unsigned indent, size_t depth);
+
+static int multiplexor_case(can_msg_t *msg, signal_t **children, const bool *selected, size_t count, FILE *c, const char *record, bool serialize, extract_e extract, dbc2c_options_t *copts, unsigned indent, size_t depth)
+{
+	const unsigned swap = msg_swap_width(msg);
+	for (size_t i = 0; i < count; i++) {
+		if (!selected[i] || signal_in_array(msg, children[i], copts))
+			continue;
+		if ((serialize ? signal2serializer(children[i], record, swap, extract, c, tabs(indent)) : signal2deserializer(children[i], record, swap, extract, c, tabs(indent))) < 0)
+			return -1;
+	}
+	for (size_t i = 0; i < count; i++)
+		if (selected[i] && children[i]->is_multiplexor)
+			if (multiplexor_dispatch(msg, children[i], c, record, serialize, extract, copts, indent, depth + 1) < 0)
+				return -1;
+	return 0;
+}
+
+/* Switch on a multiplexor and handle the signals it selects, including any
+ * multiplexors amongst them. Its values are split into intervals selecting
+ * the same signals; those no wider than MUX_CASE_LIMIT become case labels,
+ * which the compiler turns into a jump table, wider ones are tested for in
+ * the default case. Multiplexor values selecting nothing are an error. */
+static int multiplexor_dispatch(can_msg_t *msg, signal_t *multiplexor, FILE *c, const char *record, bool serialize, extract_e extract, dbc2c_options_t *copts, unsigned indent, size_t depth)
+{
+	assert(msg);
+	assert(multiplexor);
+	assert(c);
+	assert(record);
+	if (depth > msg->signal_count)
+		error("multiplexors of %s select each other", msg->name);
+	signal_t **children = allocate((msg->signal_count + 1) * sizeof(*children));
+	size_t count = 0, bounds_count = 0, intervals_count = 0;
+	for (size_t i = 0; i < msg->signal_count; i++)
+		if (msg->sigs[i]->is_multiplexed && signal_multiplexor(msg, msg->sigs[i]) == multiplexor) {
+			children[count] = msg->sigs[i];
+			bounds_count += 2 * children[count]->mux_range_count;
+			count++;
+		}
+	uint64_t *bounds = allocate((bounds_count + 1) * sizeof(*bounds));
+	mux_interval_t *intervals = allocate((bounds_count + 1) * sizeof(*intervals));
+	bool *selected = allocate((bounds_count + 1) * (count + 1) * sizeof(*selected));
+	int r = 0;
+	if (!count)
+		goto out;
+
+	bounds_count = 0;
+	for (size_t i = 0; i < count; i++)
+		for (size_t j = 0; j < children[i]->mux_range_count; j++) {
+			bounds[bounds_count++] = children[i]->mux_ranges[j].lo;
+			bounds[bounds_count++] = children[i]->mux_ranges[j].hi + 1uLL;
+		}
+	qsort(bounds, bounds_count, sizeof(*bounds), uint64_compare);
+	for (size_t i = 0; (i + 1) < bounds_count; i++) {
+		if (bounds[i] == bounds[i + 1])
+			continue;
+		mux_interval_t *in = &intervals[intervals_count];
+		bool *row = &selected[intervals_count * count], any = false;
+		in->lo = bounds[i];
+		in->hi = bounds[i + 1] - 1uLL;
+		in->group = intervals_count;
+		for (size_t j = 0; j < count; j++)
+			any |= row[j] = signal_selected_by(children[j], in->lo);
+		if (!any)
+			continue;
+		for (size_t j = 0; j < intervals_count; j++)
+			if (!memcmp(row, &selected[j * count], count * sizeof(*row))) {
+				in->group = intervals[j].group;
+				break;
+			}
+		intervals_count++;
+	}
+
+	bool wide = false;
+	fprintf(c, "%sswitch (%s%s) {\n", tabs(indent), record, multiplexor->name);
+	for (size_t i = 0; i < intervals_count; i++) {
+		if (intervals[i].group != i)
+			continue;
+		bool labels = false;
+		for (size_t j = i; j < intervals_count; j++) {
+			if (intervals[j].group != i)
+				continue;
+			if ((intervals[j].hi - intervals[j].lo) >= MUX_CASE_LIMIT) {
+				wide = true;
+				continue;
+			}
+			for (uint64_t v = intervals[j].lo; v <= intervals[j].hi; v++)
+				fprintf(c, "%scase %"PRIu64":\n", tabs(indent), v);
+			labels = true;
+		}
+		if (!labels)
+			continue;
+		if (multiplexor_case(msg, children, &selected[i * count], count, c, record, serialize, extract, copts, indent + 1, depth) < 0)
+			goto fail;
+		fprintf(c, "%sbreak;\n", tabs(indent + 1));
+	}
+	fprintf(c, "%sdefault:\n", tabs(indent));
+	if (wide) {
+		const char *prefix = "";
+		for (size_t i = 0; i < intervals_count; i++) {
+			if (intervals[i].group != i)
+				continue;
+			size_t ranges = 0;
+			for (size_t j = i; j < intervals_count; j++)
+				ranges += intervals[j].group == i && (intervals[j].hi - intervals[j].lo) >= MUX_CASE_LIMIT;
+			if (!ranges)
+				continue;
+			fprintf(c, "%s%sif (", tabs(indent + 1), prefix);
+			for (size_t j = i, k = 0; j < intervals_count; j++) {
+				if (intervals[j].group != i || (intervals[j].hi - intervals[j].lo) < MUX_CASE_LIMIT)
+					continue;
+				fputs(k++ ? " || " : "", c);
+				mux_interval2c(record, multiplexor, intervals[j].lo, intervals[j].hi, ranges > 1, c);
+			}
+			fputs(") {\n", c);
+			if (multiplexor_case(msg, children, &selected[i * count], count, c, record, serialize, extract, copts, indent + 2, depth) < 0)
+				goto fail;
+			prefix = "} else ";
+		}
+		fprintf(c, "%s} else {\n%sreturn -1;\n%s}\n%sbreak;\n", tabs(indent + 1), tabs(indent + 2), tabs(indent + 1), tabs(indent + 1));
+	} else {
+		fprintf(c, "%sreturn -1;\n", tabs(indent + 1));
+	}
+	fprintf(c, "%s}\n", tabs(indent));
+out:
+	free(children);
+	free(bounds);
+	free(intervals);
+	free(selected);
+	return r;
+fail:
+	r = -1;
+	goto out;
+}
+
+static int multiplexor_switch(can_msg_t *msg, signal_t *multiplexor, FILE *c, const char *record, bool serialize, extract_e extract, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(multiplexor);
+	assert(c);
+	if (multiplexor_dispatch(msg, multiplexor, c, record, serialize, extract, copts, 1, 0) < 0)
+		return -1;
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		size_t index = 0;
+		const signal_array_t *a = signal_array(msg, msg->sigs[i], copts, &index);
+		if (a && index == 0 && msg->sigs[i]->is_multiplexed && signal_array2loop(a, record, multiplexor, serialize, c) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+static int msg_data_type(FILE *c, can_msg_t *msg, bool data, dbc2c_options_t *copts)
+{
+	assert(c);
+	assert(msg);
+	assert(copts);
+	char name[MAX_NAME_LENGTH] = {0};
+	make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+	return fprintf(c, "\t%s_t %s%s;\n", name, name, data ? "_data" : "");
+}
+
+
+static int msg_data_type_bitfields(FILE *c, can_msg_t *msg, dbc2c_options_t *copts) {
+	assert(c);
+	assert(msg);
+	assert(copts);
+	char name[MAX_NAME_LENGTH] = {0};
+	make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+	fprintf(c, "\tunsigned %s_status : 2;\n", name); /* uninitialized, present, faulty (range/crc/timeout/other) */
+	fprintf(c, "\tunsigned %s_tx : 1;\n", name); /* have we packed this message? */
+	return fprintf(c, "\tunsigned %s_rx : 1;\n", name); /* have we unpacked this message? */
+}
+
+static int msg_data_type_sequence(FILE *c, can_msg_t *msg, dbc2c_options_t *copts) {
+	assert(c);
+	assert(msg);
+	assert(copts);
+	if (!copts->use_sequence_counter)
+		return 0;
+	char name[MAX_NAME_LENGTH] = {0};
+	make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+	return fprintf(c, "\tvolatile unsigned %s_seq;\n", name); /* odd while unpacking */
+}
+
+static int msg_data_type_time_stamp(FILE *c, can_msg_t *msg, bool aligned, dbc2c_options_t *copts) {
+	assert(c);
+	assert(msg);
+	assert(copts);
+	char name[MAX_NAME_LENGTH] = {0};
+	make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+	return fprintf(c, "\t%sdbcc_time_stamp_t %s_time_stamp_rx;\n", aligned ? "DBCC_CACHE_ALIGNED " : "", name);
+}
+
+static attribute_value *msg_attribute(can_msg_t *msg, const char *attribute)
+{
+	assert(msg);
+	assert(attribute);
+	if (!msg->attributes)
+		return NULL;
+	for (int i = 0; i < msg->attributes->attribute_value_count; i++) {
+		attribute_value *v = msg->attributes->attribute[i];
+		if (v->definition && v->definition->name && !strcmp(v->definition->name, attribute))
+			return v;
+	}
+	return NULL;
+}
+
+/* Cycle time in milliseconds from the 'GenMsgCycleTime' attribute, zero if
+ * the message is not periodic (or we do not know). */
+static int msg_cycle_time(can_msg_t *msg)
+{
+	assert(msg);
+	attribute_value *v = msg_attribute(msg, "GenMsgCycleTime");
+	if (!v || (v->definition->att_type != INT_ && v->definition->att_type != HEX_))
+		return 0;
+	return v->value.signed_integer > 0 ? v->value.signed_integer : 0;
+}
+
+/* Expected receive rate in Hz, zero if unknown. If a profile was given
+ * the share of the recorded traffic is used instead, which orders the
+ * messages in the same way. */
+static double msg_rate(can_msg_t *msg)
+{
+	assert(msg);
+	if (msg->profiled)
+		return msg->share;
+	const int cycle = msg_cycle_time(msg);
+	return cycle ? 1000.0 / cycle : 0.0;
+}
+
+static bool msg_is_high_rate(can_msg_t *msg)
+{
+	assert(msg);
+	if (msg->profiled)
+		return msg->share >= PROFILE_HIGH_RATE_SHARE;
+	const int cycle = msg_cycle_time(msg);
+	return cycle && cycle <= HIGH_RATE_CYCLE_TIME_MS;
+}
+
+static bool msg_is_cold(can_msg_t *msg)
+{
+	assert(msg);
+	return msg->profiled && msg->share < PROFILE_COLD_SHARE;
+}
+
+static unsigned signal_type_size(signal_t *sig)
+{
+	assert(sig);
+	if (sig->is_floating)
+		return sig->bit_length == 64 ? 8 : 4;
+	if (sig->bit_length <= 8)
+		return 1;
+	if (sig->bit_length <= 16)
+		return 2;
+	if (sig->bit_length <= 32)
+		return 4;
+	return 8;
+}
+
+/* size of the (packed) message structure, the real size may be larger if
+ * PREPACK/POSTPACK are not defined by the user */
+static unsigned msg_type_size(can_msg_t *msg, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(copts);
+	unsigned size = 0, branch = 0, largest = 0;
+	for (size_t i = 0; i < msg->signal_count; i++)
+		if (!signal_in_union(msg, msg->sigs[i], copts))
+			size += signal_type_size(msg->sigs[i]);
+	size_t count = 0;
+	signal_t **sigs = msg_union_signals(msg, copts, &count);
+	for (size_t i = 0; i < count; i++) {
+		if (i && sigs[i]->switchval != sigs[i - 1]->switchval)
+			branch = 0;
+		branch += signal_type_size(sigs[i]);
+		largest = branch > largest ? branch : largest;
+	}
+	free(sigs);
+	return size + largest;
+}
+
+static int message_rate_compare_function(const void *a, const void *b)
+{
+	assert(a);
+	assert(b);
+	can_msg_t *ap = *((can_msg_t**)a);
+	can_msg_t *bp = *((can_msg_t**)b);
+	const double ar = msg_rate(ap), br = msg_rate(bp);
+	if (ar > br) return -1;
+	if (ar < br) return  1;
+	if (ap->id < bp->id) return -1;
+	if (ap->id > bp->id) return  1;
+	return 0;
+}
+
+/* Messages in identifier order, or hottest first if a profile was given */
+static can_msg_t **msgs_by_profile(dbc_t *dbc, dbc2c_options_t *copts)
+{
+	assert(dbc);
+	assert(copts);
+	can_msg_t **msgs = allocate(sizeof(*msgs) * (dbc->message_count + 1));
+	memcpy(msgs, dbc->messages, sizeof(*msgs) * dbc->message_count);
+	if (copts->profile)
+		qsort(msgs, dbc->message_count, sizeof(*msgs), message_rate_compare_function);
+	return msgs;
+}
+
+/* The BMI2 variants are only used when the CPU supports them, they are
+ * selected at run time by the normal pack and unpack functions. */
+static bool msg_bmi2_variant(can_msg_t *msg, unsigned swap, bool wire_used, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(copts);
+	return copts->use_bmi2 && !copts->use_32bit_words && (swap || wire_used) && !msg_overlay_complete(msg, copts) && !msg_has_arrays(msg, copts);
+}
+
+/* Arrays are always moved with 64-bit shifts, so their messages do not use
+ * the 32-bit word path. */
+static bool msg_uses_words(can_msg_t *msg, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(copts);
+	return copts->use_32bit_words && !msg_has_arrays(msg, copts);
+}
+
+/* Variables needed by the 32-bit word path, either by every signal or only
+ * by those not copied by the memcpy overlay. */
+static void msg_word_use(can_msg_t *msg, unsigned swap, bool overlay, word_use_t *u, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(u);
+	for (size_t i = 0; i < msg->signal_count;) {
+		const size_t n = signal_run_length(msg, i, copts);
+		if (n == 1 || overlay)
+			for (size_t j = i; j < i + n; j++)
+				signal_word_use(msg->sigs[j], swap, u);
+		i += n;
+	}
+}
+
+static int word_declaration(FILE *c, bool all, bool direct, const char *declaration)
+{
+	assert(c);
+	assert(declaration);
+	if (!all)
+		return 0;
+	if (direct)
+		return fprintf(c, "\t%s\n", declaration);
+	return fprintf(c, "#ifndef DBCC_LITTLE_ENDIAN\n\t%s\n#endif\n", declaration);
+}
+
+static int msg_pack_words(can_msg_t *msg, FILE *c, const char *record, unsigned swap, bool wire_used, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(c);
+	assert(record);
+	word_use_t all = { .x = false }, direct = { .x = false };
+	msg_word_use(msg, swap, true, &all, copts);
+	msg_word_use(msg, swap, false, &direct, copts);
+	word_declaration(c, all.x,   direct.x,   "register uint32_t x;");
+	word_declaration(c, all.x64, direct.x64, "register uint64_t x64;");
+	word_declaration(c, swap,       true, "register uint32_t m0 = 0;");
+	word_declaration(c, swap == 64, true, "register uint32_t m1 = 0;");
+	word_declaration(c, wire_used,  true, "register uint32_t i0 = 0, i1 = 0;");
+
+	signal_t *multiplexor = process_signals_and_find_multiplexer(msg, c, record, true, EXTRACT_WORDS_E, copts);
+	if (multiplexor)
+		if (multiplexor_switch(msg, multiplexor, c, record, true, EXTRACT_WORDS_E, copts) < 0)
+			return -1;
+
+	char low[64] = { 0 }, high[64] = { 0 };
+	if (swap == 64) {
+		snprintf(low,  sizeof(low),  "reverse_byte_order32(m1)%s", wire_used ? " | i0" : "");
+		snprintf(high, sizeof(high), "reverse_byte_order32(m0)%s", wire_used ? " | i1" : "");
+	} else if (swap) {
+		snprintf(low,  sizeof(low),  "%s((uint%u_t)m0)%s", swap_function(swap), swap, wire_used ? " | i0" : "");
+		snprintf(high, sizeof(high), "%s", wire_used ? "i1" : "");
+	} else {
+		snprintf(low,  sizeof(low),  "i0");
+		snprintf(high, sizeof(high), "i1");
+	}
+	if (high[0])
+		return fprintf(c, "\t*data = ((uint64_t)(%s) << 32) | (%s);\n", high, low);
+	return fprintf(c, "\t*data = %s;\n", low);
+}
+
+static int msg_unpack_words(can_msg_t *msg, FILE *c, unsigned swap, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(c);
+	word_use_t all = { .x = false }, direct = { .x = false };
+	msg_word_use(msg, swap, true, &all, copts);
+	msg_word_use(msg, swap, false, &direct, copts);
+	word_declaration(c, all.x,    direct.x,    "register uint32_t x;");
+	word_declaration(c, all.x64,  direct.x64,  "register uint64_t x64;");
+	word_declaration(c, all.i[0], direct.i[0], "register uint32_t i0 = (uint32_t)data;");
+	word_declaration(c, all.i[1], direct.i[1], "register uint32_t i1 = (uint32_t)(data >> 32);");
+	if (swap == 64) {
+		word_declaration(c, all.m[0], direct.m[0], "register uint32_t m0 = reverse_byte_order32((uint32_t)(data >> 32));");
+		word_declaration(c, all.m[1], direct.m[1], "register uint32_t m1 = reverse_byte_order32((uint32_t)data);");
+	} else if (swap) {
+		char declaration[96] = { 0 };
+		snprintf(declaration, sizeof(declaration), "register uint32_t m0 = %s((uint%u_t)data);", swap_function(swap), swap);
+		word_declaration(c, all.m[0], direct.m[0], declaration);
+	}
+	return 0;
+}
+
+/* The name of the pack or unpack function of a message that does the work,
+ * with '-q' it is a static function wrapped by msg_sequence_wrappers */
+static const char *msg_body_prefix(bool unpack, dbc2c_options_t *copts)
+{
+	assert(copts);
+	if (copts->use_sequence_counter)
+		return unpack ? "unpack_body" : "pack_body";
+	return unpack ? "unpack" : "pack";
+}
+
+/* With 'layout' set the function packs a copy of the structure of any
+ * message with the same layout (see '-d'), made through a pointer to it, and
+ * does not set the transmit status bit */
+static int msg_pack(can_msg_t *msg, FILE *c, const char *name, unsigned swap, bool wire_used, bool bmi2, bool layout, const char *god, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(c);
+	assert(name);
+	assert(copts);
+	const bool message_has_signals = swap || wire_used;
+	const char *object = layout ? "in" : "o";
+	char record[MAX_NAME_LENGTH + 8] = {0};
+	if (layout)
+		snprintf(record, sizeof(record), "msg.");
+	else
+		msg_record(record, sizeof(record), name);
+	if (bmi2)
+		fputs("#ifdef DBCC_BMI2\nDBCC_BMI2_TARGET ", c);
+	if (!layout && msg_is_cold(msg))
+		fputs("DBCC_COLD ", c);
+	if (layout)
+		fprintf(c, "%sint %s_%s(const void *in, uint64_t *data) {\n", bmi2 || !copts->split ? "static " : "", bmi2 ? "pack_bmi2_layout" : "pack_layout", name);
+	else
+		print_function_name(c, bmi2 ? "pack_bmi2" : msg_body_prefix(false, copts), name, " {\n", false, "uint64_t", false, god, !bmi2 && !copts->use_sequence_counter && copts->split);
+	if (copts->generate_asserts && !bmi2) {
+		fprintf(c, "\tassert(%s);\n", object);
+		fprintf(c, "\tassert(data);\n");
+	}
+	if (!bmi2 && msg_bmi2_variant(msg, swap, wire_used, copts))
+		fprintf(c, "#ifdef DBCC_BMI2\n\tif (dbcc_has_bmi2())\n\t\treturn pack_bmi2%s_%s(%s, data);\n#endif\n", layout ? "_layout" : "", name, object);
+	if (layout)
+		fprintf(c, "\t%s_t msg;\n\tmemcpy(&msg, in, sizeof(msg));\n", name);
+	if (message_has_signals && msg_uses_words(msg, copts)) {
+		if (msg_pack_words(msg, c, record, swap, wire_used, copts) < 0)
+			return -1;
+		if (!layout)
+			fprintf(c, "\to->%s_tx = 1;\n", name);
+		fprintf(c, "\treturn 0;\n}\n\n");
+		return 0;
+	}
+	if (message_has_signals)
+		fprintf(c, msg_overlay_complete(msg, copts) ? "#ifndef DBCC_LITTLE_ENDIAN\n\tregister uint64_t x;\n#endif\n" : "\tregister uint64_t x;\n");
+	if (swap)
+		fprintf(c, "\tregister uint64_t m = 0;\n");
+	if (wire_used)
+		fprintf(c, "\tregister uint64_t i = 0;\n");
+	if (!message_has_signals)
+		fprintf(c, "\tDBCC_UNUSED(%s);\n\tDBCC_UNUSED(data);\n", object);
+	const extract_e extract = bmi2 ? EXTRACT_BMI2_E : EXTRACT_SHIFT_E;
+	signal_t *multiplexor = process_signals_and_find_multiplexer(msg, c, record, true, extract, copts);
+
+	if (multiplexor)
+		if (multiplexor_switch(msg, multiplexor, c, record, true, extract, copts) < 0)
+			return -1;
+
+	if (message_has_signals) {
+		if (swap == 64)
+			fprintf(c, "\t*data = reverse_byte_order(m)%s;\n", wire_used ? "|(i)" : "");
+		else if (swap)
+			fprintf(c, "\t*data = (uint64_t)%s((uint%u_t)m)%s;\n", swap_function(swap), swap, wire_used ? "|(i)" : "");
+		else
+			fprintf(c, "\t*data = (i);\n");
+	}
+	if (!layout)
+		fprintf(c, "\to->%s_tx = 1;\n", name);
+	fprintf(c, "\treturn 0;\n}\n%s\n", bmi2 ? "#endif\n" : "");
+	return 0;
+}
+
+/* With 'layout' set the function unpacks into a copy of the structure of any
+ * message with the same layout, which is only written back if the frame is
+ * accepted, see msg_pack */
+static int msg_unpack(can_msg_t *msg, FILE *c, const char *name, unsigned swap, bool wire_used, bool bmi2, bool layout, const char *god, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(c);
+	assert(name);
+	assert(copts);
+	const bool message_has_signals = swap || wire_used;
+	const char *object = layout ? "out" : "o";
+	char record[MAX_NAME_LENGTH + 8] = {0};
+	if (layout)
+		snprintf(record, sizeof(record), "msg.");
+	else
+		msg_record(record, sizeof(record), name);
+	if (bmi2)
+		fputs("#ifdef DBCC_BMI2\nDBCC_BMI2_TARGET ", c);
+	if (!layout && msg_is_cold(msg))
+		fputs("DBCC_COLD ", c);
+	if (layout)
+		fprintf(c, "%sint %s_%s(void *out, uint64_t data, uint8_t dlc) {\n", bmi2 || !copts->split ? "static " : "", bmi2 ? "unpack_bmi2_layout" : "unpack_layout", name);
+	else
+		print_function_name(c, bmi2 ? "unpack_bmi2" : msg_body_prefix(true, copts), name, " {\n", true, "uint64_t", true, god, !bmi2 && !copts->use_sequence_counter && copts->split);
+	if (copts->generate_asserts && !bmi2) {
+		fprintf(c, "\tassert(%s);\n", object);
+		fprintf(c, "\tassert(dlc <= 8);\n");
+	}
+	/* short frames are rejected before any of the frame is swapped or read */
+	if (msg->dlc)
+		fprintf(c, "\tif (dlc < %u)\n\t\treturn -1;\n", msg->dlc);
+	else
+		fprintf(c, "\tDBCC_UNUSED(dlc);\n");
+	if (!bmi2 && msg_bmi2_variant(msg, swap, wire_used, copts)) {
+		if (layout)
+			fprintf(c, "#ifdef DBCC_BMI2\n\tif (dbcc_has_bmi2())\n\t\treturn unpack_bmi2_layout_%s(out, data, dlc);\n#endif\n", name);
+		else
+			fprintf(c, "#ifdef DBCC_BMI2\n\tif (dbcc_has_bmi2())\n\t\treturn unpack_bmi2_%s(o, data, dlc, time_stamp);\n#endif\n", name);
+	}
+	if (layout)
+		fprintf(c, "\t%s_t msg;\n\tmemcpy(&msg, out, sizeof(msg));\n", name);
+	if (message_has_signals && msg_uses_words(msg, copts)) {
+		msg_unpack_words(msg, c, swap, copts);
+	} else {
+		if (message_has_signals && msg_overlay_complete(msg, copts))
+			fprintf(c, "#ifndef DBCC_LITTLE_ENDIAN\n\tregister uint64_t x;\n\tregister uint64_t i = (data);\n#endif\n");
+		else if (message_has_signals)
+			fprintf(c, "\tregister uint64_t x;\n");
+		if (swap == 64)
+			fprintf(c, "\tregister uint64_t m = reverse_byte_order(data);\n");
+		else if (swap)
+			fprintf(c, "\tregister uint64_t m = %s((uint%u_t)data);\n", swap_function(swap), swap);
+		if (wire_used && !msg_overlay_complete(msg, copts))
+			fprintf(c, "\tregister uint64_t i = (data);\n");
+	}
+	if (!message_has_signals)
+		fprintf(c, "\tDBCC_UNUSED(%s);\n\tDBCC_UNUSED(data);\n", object);
+
+	const extract_e extract = bmi2 ? EXTRACT_BMI2_E : msg_uses_words(msg, copts) ? EXTRACT_WORDS_E : EXTRACT_SHIFT_E;
+	signal_t *multiplexor = process_signals_and_find_multiplexer(msg, c, record, false, extract, copts);
+	if (multiplexor)
+		if (multiplexor_switch(msg, multiplexor, c, record, false, extract, copts) < 0)
+			return -1;
+	if (layout) {
+		fprintf(c, "\tmemcpy(out, &msg, sizeof(msg));\n");
+	} else {
+		fprintf(c, "\to->%s_rx = 1;\n", name);
+		fprintf(c, "\to->%s_time_stamp_rx = time_stamp;\n", name);
+	}
+	fprintf(c, "\treturn 0;\n}\n%s\n", bmi2 ? "#endif\n" : "");
+	return 0;
+}
+
+/* number of decimal places needed to show a scaled value exactly, or at
+ * least to a sensible precision */
+static unsigned signal_format_decimals(signal_t *sig)
+{
+	assert(sig);
+	if (sig->is_floating)
+		return FORMAT_MAX_DECIMALS;
+	double scale = 1.0;
+	for (unsigned d = 0; d < FORMAT_MAX_DECIMALS; d++, scale *= 10.0)
+		if (is_integer(sig->scaling * scale) && is_integer(sig->offset * scale))
+			return d;
+	return FORMAT_MAX_DECIMALS;
+}
+
+static bool signal_is_scaled(signal_t *sig)
+{
+	assert(sig);
+	return sig->is_floating || sig->scaling != 1.0 || sig->offset != 0.0;
+}
+
+/* DBC strings can contain anything, so they are escaped before they are
+ * put into a C string literal, octal escapes end after three digits */
+static int print_c_escaped(FILE *o, const char *string)
+{
+	assert(o);
+	assert(string);
+	for (const unsigned char *s = (const unsigned char*)string; *s; s++) {
+		int r = 0;
+		if (*s == '"' || *s == '\\' || *s == '?')
+			r = fprintf(o, "\\%c", *s);
+		else if (*s < 0x20 || *s > 0x7E)
+			r = fprintf(o, "\\%03o", *s);
+		else
+			r = fputc(*s, o);
+		if (r < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/* upper bound on the number of characters formatting a signal produces */
+static size_t signal_format_size(signal_t *sig, const char *field)
+{
+	assert(sig);
+	assert(field);
+	size_t label = 0;
+	if (sig->val_list)
+		for (size_t i = 0; i < sig->val_list->val_list_item_count; i++) {
+			const size_t l = strlen(sig->val_list->val_list_items[i]->name);
+			label = l > label ? l : label;
+		}
+	/* "name = " sign, 20 digits, '.', decimals or exponent, " units", " (label)", '\n' */
+	return strlen(field) + 3 + 1 + 20 + 1 + FORMAT_MAX_DECIMALS + 4
+		+ 1 + (sig->units ? strlen(sig->units) : 0) + 3 + label + 1;
+}
+
+/* format the physical value of a signal, JSON has no representation for
+ * NaN or infinity so 'null' is used for those instead */
+static int signal2format_value(signal_t *sig, const char *msg_name, const char *field, FILE *o, const char *indent, bool json)
+{
+	assert(sig);
+	assert(msg_name);
+	assert(field);
+	assert(o);
+	assert(indent);
+	if (signal_is_scaled(sig)) {
+		fprintf(o, "%sat = %s(buf, len, at, ((double)(o->%s.%s))", indent,
+				json && sig->is_floating ? "fmt_json_fixed" : "fmt_fixed", msg_name, field);
+		/* the constants are printed as signal2decode_body does, so the
+		 * value formatted is the value decoded */
+		if (sig->scaling != 1.0)
+			fprintf(o, " * %g", sig->scaling);
+		if (sig->offset != 0.0)
+			fprintf(o, " %c %g", sig->offset < 0.0 ? '-' : '+', sig->offset < 0.0 ? -sig->offset : sig->offset);
+		return fprintf(o, ", %u);\n", signal_format_decimals(sig));
+	}
+	if (sig->is_signed)
+		return fprintf(o, "%sat = fmt_i64(buf, len, at, o->%s.%s);\n", indent, msg_name, field);
+	return fprintf(o, "%sat = fmt_u64(buf, len, at, o->%s.%s);\n", indent, msg_name, field);
+}
+
+static int signal2format(can_msg_t *msg, signal_t *sig, const char *msg_name, const char *field, FILE *o)
+{
+	assert(msg);
+	assert(sig);
+	assert(msg_name);
+	assert(field);
+	assert(o);
+	const char *indent = "\t";
+	const bool multiplexed = sig->is_multiplexed && signal_multiplexor(msg, sig);
+	if (multiplexed) {
+		char record[MAX_NAME_LENGTH + 8] = {0};
+		msg_record(record, sizeof(record), msg_name);
+		fputs("\tif (", o);
+		signal_active2c(msg, sig, record, o, 0);
+		fputs(") {\n", o);
+		indent = "\t\t";
+	}
+	fprintf(o, "%sat = fmt_str(buf, len, at, \"%s = \");\n", indent, field);
+	if (signal2format_value(sig, msg_name, field, o, indent, false) < 0)
+		return -1;
+	if (sig->units && sig->units[0]) {
+		fprintf(o, "%sat = fmt_str(buf, len, at, \" ", indent);
+		print_c_escaped(o, sig->units);
+		fputs("\");\n", o);
+	}
+	if (sig->val_list && sig->val_list->val_list_item_count && !sig->is_floating) {
+		val_list_t *list = sig->val_list;
+		fprintf(o, "%sswitch (o->%s.%s) {\n", indent, msg_name, field);
+		for (size_t i = 0; i < list->val_list_item_count; i++) {
+			val_list_item_t *item = list->val_list_items[i];
+			if (i && item->value == list->val_list_items[i - 1]->value)
+				continue; /* sorted, so duplicates are adjacent */
+			fprintf(o, "%scase %u: at = fmt_str(buf, len, at, \" (", indent, item->value);
+			print_c_escaped(o, item->name);
+			fputs(")\"); break;\n", o);
+		}
+		fprintf(o, "%sdefault: break;\n%s}\n", indent, indent);
+	}
+	fprintf(o, "%sat = fmt_char(buf, len, at, '\\n');\n", indent);
+	if (multiplexed)
+		fputs("\t}\n", o);
+	return 0;
+}
+
+/* Format a message into a caller supplied buffer, with the same semantics
+ * as snprintf; the output is always NUL terminated (if 'len' is not zero)
+ * and the number of characters that would have been written is returned. */
+static int msg_format(can_msg_t *msg, FILE *c, const char *name, const char *god, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(c);
+	assert(name);
+	assert(god);
+	assert(copts);
+	fprintf(c, "int format_%s(const can_obj_%s_t *o, char *buf, size_t len) {\n", name, god);
+	if (copts->generate_asserts) {
+		fputs("\tassert(o);\n", c);
+		fputs("\tassert(buf || len == 0);\n", c);
+	}
+	fputs("\tsize_t at = 0;\n", c);
+	if (!msg->signal_count)
+		fprintf(c, "\tDBCC_UNUSED(o);\n");
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		char field[MAX_NAME_LENGTH * 2] = {0};
+		signal_field(msg, msg->sigs[i], copts, field, sizeof(field));
+		if (signal2format(msg, msg->sigs[i], name, field, c) < 0)
+			return -1;
+	}
+	fputs("\tif (len)\n\t\tbuf[at < len ? at : len - 1] = '\\0';\n", c);
+	return fputs("\treturn at;\n}\n\n", c) < 0 ? -1 : 0;
+}
+
+static int msg_serialize_prologue(FILE *c, const char *kind, const char *name, const char *god, dbc2c_options_t *copts)
+{
+	assert(c);
+	assert(kind);
+	assert(name);
+	assert(god);
+	assert(copts);
+	fprintf(c, "int serialize_%s_%s(const can_obj_%s_t *o, char *buf, size_t len) {\n", kind, name, god);
+	if (copts->generate_asserts) {
+		fputs("\tassert(o);\n", c);
+		fputs("\tassert(buf || len == 0);\n", c);
+	}
+	return fputs("\tsize_t at = 0;\n", c);
+}
+
+static int msg_serialize_text_epilogue(FILE *c)
+{
+	assert(c);
+	fputs("\tat = fmt_char(buf, len, at, '\\n');\n", c);
+	fputs("\tif (len)\n\t\tbuf[at < len ? at : len - 1] = '\\0';\n", c);
+	return fputs("\treturn at;\n}\n\n", c);
+}
+
+/* One JSON object per line (NDJSON), inactive multiplexed signals are left
+ * out of the object. */
+static int msg_serialize_json(can_msg_t *msg, FILE *c, const char *name, const char *god, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(c);
+	assert(name);
+	assert(god);
+	assert(copts);
+	char record[MAX_NAME_LENGTH + 8] = {0};
+	msg_record(record, sizeof(record), name);
+	msg_serialize_prologue(c, "json", name, god, copts);
+	fputs("\tat = fmt_str(buf, len, at, \"{\\\"t\\\":\");\n", c);
+	fprintf(c, "\tat = fmt_u64(buf, len, at, o->%s_time_stamp_rx);\n", name);
+	fprintf(c, "\tat = fmt_str(buf, len, at, \",\\\"id\\\":%lu,\\\"name\\\":\\\"%s\\\"\");\n", msg->id, msg->name);
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		signal_t *sig = msg->sigs[i];
+		const char *indent = "\t";
+		char field[MAX_NAME_LENGTH * 2] = {0};
+		signal_field(msg, sig, copts, field, sizeof(field));
+		const bool multiplexed = sig->is_multiplexed && signal_multiplexor(msg, sig);
+		if (multiplexed) {
+			fputs("\tif (", c);
+			signal_active2c(msg, sig, record, c, 0);
+			fputs(") {\n", c);
+			indent = "\t\t";
+		}
+		fprintf(c, "%sat = fmt_str(buf, len, at, \",\\\"%s\\\":\");\n", indent, field);
+		if (signal2format_value(sig, name, field, c, indent, true) < 0)
+			return -1;
+		if (multiplexed)
+			fputs("\t}\n", c);
+	}
+	fputs("\tat = fmt_char(buf, len, at, '}');\n", c);
+	return msg_serialize_text_epilogue(c) < 0 ? -1 : 0;
+}
+
+/* Time stamp, identifier and then a column per signal, in the same order
+ * as in the message structure; inactive multiplexed signals are empty. */
+static int msg_serialize_csv(can_msg_t *msg, FILE *c, const char *name, const char *god, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(c);
+	assert(name);
+	assert(god);
+	assert(copts);
+	char record[MAX_NAME_LENGTH + 8] = {0};
+	msg_record(record, sizeof(record), name);
+	msg_serialize_prologue(c, "csv", name, god, copts);
+	fprintf(c, "\tat = fmt_u64(buf, len, at, o->%s_time_stamp_rx);\n", name);
+	fprintf(c, "\tat = fmt_str(buf, len, at, \",%lu\");\n", msg->id);
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		signal_t *sig = msg->sigs[i];
+		const char *indent = "\t";
+		char field[MAX_NAME_LENGTH * 2] = {0};
+		signal_field(msg, sig, copts, field, sizeof(field));
+		fputs("\tat = fmt_char(buf, len, at, ',');\n", c);
+		if (sig->is_multiplexed && signal_multiplexor(msg, sig)) {
+			fputs("\tif (", c);
+			signal_active2c(msg, sig, record, c, 0);
+			fputs(")\n", c);
+			indent = "\t\t";
+		}
+		if (signal2format_value(sig, name, field, c, indent, false) < 0)
+			return -1;
+	}
+	return msg_serialize_text_epilogue(c) < 0 ? -1 : 0;
+}
+
+/* Little endian; a 64-bit time stamp, a 32-bit identifier, then the raw
+ * (unscaled) value of each signal in the order and size of the message
+ * structure. The record size is fixed per message, the number of bytes
+ * needed is returned and nothing is written past 'len'. */
+static int msg_serialize_bin(can_msg_t *msg, FILE *c, const char *name, const char *god, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(c);
+	assert(name);
+	assert(god);
+	assert(copts);
+	msg_serialize_prologue(c, "bin", name, god, copts);
+	fprintf(c, "\tat = ser_le(buf, len, at, o->%s_time_stamp_rx, 8);\n", name);
+	fprintf(c, "\tat = ser_le(buf, len, at, 0x%lxuL, 4);\n", msg->id);
+	signal_t *multiplexor = find_multiplexor(msg);
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		signal_t *sig = msg->sigs[i];
+		const unsigned size = signal_type_size(sig);
+		char field[MAX_NAME_LENGTH * 2] = {0}, value[MAX_NAME_LENGTH * 6] = {0};
+		signal_field(msg, sig, copts, field, sizeof(field));
+		if (signal_in_union(msg, sig, copts)) /* inactive union members are zero */
+			snprintf(value, sizeof(value) - 1, "(o->%s.%s == %u ? o->%s.%s : 0)", name, multiplexor->name, sig->switchval, name, field);
+		else
+			snprintf(value, sizeof(value) - 1, "o->%s.%s", name, field);
+		if (sig->is_floating) {
+			fprintf(c, "\t{\n\t\tconst %s f = %s;\n", size == 8 ? "double" : "float", value);
+			fprintf(c, "\t\tuint%u_t u = 0;\n\t\tmemcpy(&u, &f, sizeof(u));\n", size * 8);
+			fprintf(c, "\t\tat = ser_le(buf, len, at, u, %u);\n\t}\n", size);
+			continue;
+		}
+		fprintf(c, "\tat = ser_le(buf, len, at, %s, %u);\n", value, size);
+	}
+	return fputs("\treturn at;\n}\n\n", c) < 0 ? -1 : 0;
+}
+
+static int msg_serialize(can_msg_t *msg, FILE *c, const char *name, const char *god, dbc2c_options_t *copts)
+{
+	if (msg_serialize_json(msg, c, name, god, copts) < 0)
+		return -1;
+	if (msg_serialize_csv(msg, c, name, god, copts) < 0)
+		return -1;
+	return msg_serialize_bin(msg, c, name, god, copts);
+}
+
+static int msg_print_formatted(can_msg_t *msg, FILE *c, const char *name, const char *god, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(c);
+	assert(name);
+	assert(god);
+	assert(copts);
+	size_t size = 1;
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		char field[MAX_NAME_LENGTH * 2] = {0};
+		signal_field(msg, msg->sigs[i], copts, field, sizeof(field));
+		size += signal_format_size(msg->sigs[i], field);
+	}
+	fprintf(c, "int print_%s(const can_obj_%s_t *o, FILE *output) {\n", name, god);
+	if (copts->generate_asserts) {
+		fputs("\tassert(o);\n", c);
+		fputs("\tassert(output);\n", c);
+	}
+	fprintf(c, "\tchar buf[%zu];\n", size);
+	fprintf(c, "\tconst int r = format_%s(o, buf, sizeof(buf));\n", name);
+	fputs("\tif (r < 0 || (size_t)r >= sizeof(buf))\n\t\treturn -1;\n", c);
+	fputs("\treturn fwrite(buf, 1, r, output) == (size_t)r ? r : -1;\n}\n\n", c);
+	return 0;
+}
+
+static int msg_print(can_msg_t *msg, FILE *c, const char *name, const char *god, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(c);
+	assert(name);
+	assert(god);
+	assert(copts);
+	if (copts->generate_format)
+		return msg_print_formatted(msg, c, name, god, copts);
+	fprintf(c, "int print_%s(const can_obj_%s_t *o, FILE *output) {\n", name, god);
+	if (copts->generate_asserts) {
+		fputs("\tassert(o);\n", c);
+		fputs("\tassert(output);\n", c);
+		/* you may note the DBCC_UNUSED macro may be generated, we should
+		 * still assert we are passed the correct things */
+	}
+	if (msg->signal_count)
+		fprintf(c, "\tint r = 0;\n"); //fprintf(c, "\tdouble scaled;\n\tint r = 0;\n");
+	else
+		fprintf(c, "\tDBCC_UNUSED(o);\n\tDBCC_UNUSED(output);\n");
+	signal_t *multiplexor = find_multiplexor(msg);
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		char field[MAX_NAME_LENGTH * 2] = {0};
+		signal_field(msg, msg->sigs[i], copts, field, sizeof(field));
+		if (signal_in_union(msg, msg->sigs[i], copts))
+			fprintf(c, "\tif (o->%s.%s == %u)\n\t", name, multiplexor->name, msg->sigs[i]->switchval);
+		if (signal2print(msg->sigs[i], msg->id, name, field, c) < 0)
+			return -1;
+	}
+	if (msg->signal_count)
+		fprintf(c, "\treturn r;\n}\n\n");
+	else
+		fprintf(c, "\treturn 0;\n}\n\n");
+	return 0;
+}
+
+static int msg_range_check(can_msg_t *msg)
+{
+	assert(msg);
+	int r = 0;
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		signal_t *sig = msg->sigs[i];
+		raw_bounds_t b;
+		if (signal_raw_bounds(sig, &b) && b.lo > b.hi) {
+			warning("Signal %s can never be within [%g, %g] (fix your DBC file)", sig->name, sig->minimum, sig->maximum);
+			r = -1;
+		}
+	}
+	return r;
+}
+
+static int msg_dlc_check(can_msg_t *msg) {
+	assert(msg);
+	const unsigned bits = msg->dlc * 8;
+	unsigned used = 0;
+	if (find_multiplexor(msg)) // skip multiplexed messages for now
+		return 0;
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		signal_t *s = msg->sigs[i];
+		used += s->bit_length;
+	}
+	if (used > bits) {
+		warning("Too many signals, not enough bytes (DLC is too low, fix your DBC file): %s", msg->name);
+		return -1;
+	}
+	for (size_t i = 0; msg->dlc && i < msg->signal_count; i++) {
+		signal_t *s = msg->sigs[i];
+		if (signal_last_byte(s) >= msg->dlc) {
+			warning("Signal %s lies past the DLC of %s (fix your DBC file)", s->name, msg->name);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* The signals of a group that are in the message, signals dropped by '-n'
+ * are left out of the group as well */
+static size_t group_signals(can_msg_t *msg, signal_group_t *group, signal_t **sigs)
+{
+	assert(msg);
+	assert(group);
+	size_t count = 0;
+	for (size_t i = 0; i < group->signal_count; i++)
+		for (size_t j = 0; j < msg->signal_count; j++)
+			if (group->sigs[i] == msg->sigs[j]) {
+				if (sigs)
+					sigs[count] = group->sigs[i];
+				count++;
+				break;
+			}
+	return count;
+}
+
+static bool group_is_generated(can_msg_t *msg, signal_group_t *group, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(group);
+	assert(copts);
+	if (!msg_generate_unpack(msg, copts) && !msg_generate_pack(msg, copts))
+		return false;
+	return group_signals(msg, group, NULL) > 0;
+}
+
+/* Whether a group getter reads the signal, or an element of its array */
+static bool signal_in_group(can_msg_t *msg, signal_t *sig, const signal_array_t *array, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(sig);
+	assert(copts);
+	if (!msg_generate_unpack(msg, copts))
+		return false;
+	for (size_t i = 0; i < msg->group_count; i++) {
+		signal_group_t *group = msg->groups[i];
+		if (!group_is_generated(msg, group, copts))
+			continue;
+		for (size_t j = 0; j < group->signal_count; j++) {
+			signal_t *member = group->sigs[j];
+			if (member == sig || (array && signal_array(msg, member, copts, NULL) == array))
+				return true;
+		}
+	}
+	return false;
+}
+
+/* With '-d' the conversions of a signal that is scaled or range checked are
+ * shared between the messages with the same layout, as long as they have the
+ * same range, through the helpers of the signal at the same place in the
+ * first of the messages. Returns that signal, or NULL if nothing is shared. */
+static signal_t *signal_shared_conversion(can_msg_t *msg, signal_t *sig)
+{
+	assert(msg);
+	assert(sig);
+	if (!msg->layout)
+		return NULL;
+	raw_bounds_t b;
+	if (sig->scaling == 1.0 && sig->offset == 0.0 && !signal_raw_bounds(sig, &b))
+		return NULL;
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		if (msg->sigs[i] != sig)
+			continue;
+		signal_t *twin = msg->layout->sigs[i];
+		return twin->minimum == sig->minimum && twin->maximum == sig->maximum ? twin : NULL;
+	}
+	return NULL;
+}
+
+/* The helper that converts between the raw and the physical value of a
+ * signal, or the first element of an array, if its encode or decode function
+ * calls one: a shared conversion or, for decoding, a signal in a group */
+static bool signal_raw_helper(can_msg_t *msg, signal_t *sig, bool decode, char *fname, size_t maxlen, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(sig);
+	assert(fname);
+	assert(copts);
+	signal_t *twin = signal_shared_conversion(msg, sig);
+	can_msg_t *owner = twin ? msg->layout : msg;
+	const signal_array_t *a = signal_array(msg, sig, copts, NULL);
+	if (!twin && !(decode && signal_in_group(msg, sig, a, copts)))
+		return false;
+	if (twin)
+		a = signal_array(owner, twin, copts, NULL);
+	else
+		twin = sig;
+	signal_raw_name(decode ? "decode" : "encode", owner->id, a ? a->name : twin->name, fname, maxlen, copts);
+	return true;
+}
+
+/* Encode and decode functions for the signals of a message, the elements of
+ * an array share one pair of functions. */
+static int msg2scaling(can_msg_t *msg, const char *name, FILE *o, bool header, const char *god, size_t *budget, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(name);
+	assert(o);
+	assert(copts);
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		signal_t *sig = msg->sigs[i];
+		size_t index = 0;
+		const signal_array_t *a = signal_array(msg, sig, copts, &index);
+		int r = 0;
+		if (!a || index == 0) {
+			char decode[MAX_NAME_LENGTH * 2] = {0}, encode[MAX_NAME_LENGTH * 2] = {0};
+			const bool shared = signal_shared_conversion(msg, sig) != NULL;
+			const bool d = signal_raw_helper(msg, sig, true, decode, sizeof(decode), copts);
+			const bool e = signal_raw_helper(msg, sig, false, encode, sizeof(encode), copts);
+			if (msg_generate_unpack(msg, copts) && signal2scaling(name, msg->id, sig, o, true, header, god, budget, a, d ? decode : NULL, !shared, copts) < 0)
+				r = -1;
+			if (msg_generate_pack(msg, copts) && signal2scaling(name, msg->id, sig, o, false, header, god, NULL, a, e ? encode : NULL, false, copts) < 0)
+				r = -1;
+		}
+		if (r < 0)
+			return -1;
+	}
+	return 0;
+}
+
+static int group2type(can_msg_t *msg, signal_group_t *group, FILE *h, const char *name, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(group);
+	assert(h);
+	assert(name);
+	assert(copts);
+	signal_t **sigs = allocate(sizeof(*sigs) * (group->signal_count + 1));
+	const size_t count = group_signals(msg, group, sigs);
+	fprintf(h, "typedef struct { /* signal group %s */\n", group->name);
+	for (size_t i = 0; i < count; i++)
+		fprintf(h, "\t%s %s;\n", signal_encode_type(sigs[i], copts), sigs[i]->name);
+	free(sigs);
+	return fprintf(h, "} %s_%s_t;\n\n", name, group->name);
+}
+
+/* The decode or encode call for one signal of a group. Getters decode the
+ * raw value copied into 'raw_<signal>', setters encode through the function
+ * of the signal, for array elements that of their array with their index */
+static int group_signal_call(can_msg_t *msg, signal_t *sig, FILE *c, bool decode, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(sig);
+	assert(c);
+	assert(copts);
+	size_t index = 0;
+	const signal_array_t *a = signal_array(msg, sig, copts, &index);
+	char fname[MAX_NAME_LENGTH * 2] = {0}, arg[MAX_NAME_LENGTH] = {0};
+	if (decode && signal_raw_helper(msg, a ? a->elements[0] : sig, true, fname, sizeof(fname), copts))
+		return fprintf(c, "\tr |= %s(raw_%s, &out->%s);\n", fname, sig->name, sig->name);
+	if (copts->use_id_in_name)
+		snprintf(fname, sizeof(fname) - 1, "%s_can_0x%03lx_%s", decode ? "decode" : "encode", msg->id, a ? a->name : sig->name);
+	else
+		snprintf(fname, sizeof(fname) - 1, "%s_can_%s", decode ? "decode" : "encode", a ? a->name : sig->name);
+	if (a)
+		snprintf(arg, sizeof(arg) - 1, ", %zu", index);
+	return fprintf(c, "\tr |= %s(o%s, in->%s);\n", fname, arg, sig->name);
+}
+
+/* Decode (get) or encode (set) all signals of a group in one call. A getter
+ * copies the raw values of the group out of the message in one pass and
+ * decodes them afterwards. With a sequence counter, which is odd while a
+ * frame for the message is being unpacked, the copy is retried until it is
+ * not torn, which keeps the decoding out of the retried part. */
+static int group2function(can_msg_t *msg, signal_group_t *group, FILE *o, const char *name, bool get, bool header, const char *god, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(group);
+	assert(o);
+	assert(name);
+	assert(god);
+	assert(copts);
+	accessor_linkage(o, header, copts);
+	if (get)
+		fprintf(o, "int get_group_%s_%s(const can_obj_%s_t *o, %s_%s_t *out)", name, group->name, god, name, group->name);
+	else
+		fprintf(o, "int set_group_%s_%s(can_obj_%s_t *o, const %s_%s_t *in)", name, group->name, god, name, group->name);
+	if (header)
+		return fputs(";\n", o);
+	fputs(" {\n", o);
+	if (copts->generate_asserts)
+		fprintf(o, "\tassert(o);\n\tassert(%s);\n", get ? "out" : "in");
+	signal_t **sigs = allocate(sizeof(*sigs) * (group->signal_count + 1));
+	const size_t count = group_signals(msg, group, sigs);
+	const bool seq = copts->use_sequence_counter;
+	fputs("\tint r = 0;\n", o);
+	if (get) {
+		for (size_t i = 0; i < count; i++)
+			fprintf(o, "\t%s raw_%s;\n", determine_type(sigs[i]->bit_length, sigs[i]->is_signed, sigs[i]->is_floating), sigs[i]->name);
+		if (seq)
+			fprintf(o, "\tunsigned seq = 0;\n\tdo {\n\t\tseq = o->%s_seq;\n\t\tDBCC_SEQ_BARRIER();\n", name);
+		for (size_t i = 0; i < count; i++) {
+			char field[MAX_NAME_LENGTH * 2] = {0};
+			signal_field(msg, sigs[i], copts, field, sizeof(field));
+			fprintf(o, "%sraw_%s = o->%s.%s;\n", seq ? "\t\t" : "\t", sigs[i]->name, name, field);
+		}
+		if (seq)
+			fprintf(o, "\t\tDBCC_SEQ_BARRIER();\n\t} while ((seq & 1u) || seq != o->%s_seq);\n", name);
+	}
+	if (!get && seq)
+		fprintf(o, "\to->%s_seq++;\n\tDBCC_SEQ_BARRIER();\n", name);
+	for (size_t i = 0; i < count; i++)
+		if (group_signal_call(msg, sigs[i], o, get, copts) < 0) {
+			free(sigs);
+			return -1;
+		}
+	free(sigs);
+	if (!get && seq)
+		fprintf(o, "\tDBCC_SEQ_BARRIER();\n\to->%s_seq++;\n", name);
+	return fputs("\treturn r ? -1 : 0;\n}\n\n", o);
+}
+
+static int msg2groups(can_msg_t *msg, FILE *o, const char *name, bool header, const char *god, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(o);
+	assert(name);
+	assert(god);
+	assert(copts);
+	for (size_t i = 0; i < msg->group_count; i++) {
+		signal_group_t *group = msg->groups[i];
+		if (!group_is_generated(msg, group, copts))
+			continue;
+		if (msg_generate_unpack(msg, copts) && group2function(msg, group, o, name, true, header, god, copts) < 0)
+			return -1;
+		if (msg_generate_pack(msg, copts) && group2function(msg, group, o, name, false, header, god, copts) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/* Messages whose signals have the same layout, that is the same positions,
+ * types, scaling and multiplexing whatever they are named, share one pack
+ * and one unpack function. The structures of such messages have the same
+ * members in the same order, so the shared functions work on a copy of the
+ * structure of the first message. Each message keeps a small wrapper that
+ * sets its own status bits and time stamp. Messages are bucketed by a hash
+ * of their signal geometry and only compared in full within a bucket. */
+static uint64_t hash_bytes(uint64_t h, const void *p, size_t n)
+{
+	assert(p);
+	const unsigned char *b = p;
+	for (size_t i = 0; i < n; i++)
+		h = (h ^ b[i]) * 0x100000001B3uLL; /* FNV-1a */
+	return h;
+}
+
+static uint64_t msg_layout_hash(can_msg_t *msg)
+{
+	assert(msg);
+	uint64_t h = hash_bytes(0xCBF29CE484222325uLL, &msg->dlc, sizeof(msg->dlc));
+	h = hash_bytes(h, &msg->signal_count, sizeof(msg->signal_count));
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		signal_t *sig = msg->sigs[i];
+		const unsigned geometry[] = {
+			sig->start_bit, sig->bit_length, sig->endianess, sig->is_signed,
+			sig->is_floating, sig->is_multiplexor, sig->is_multiplexed, sig->switchval,
+		};
+		h = hash_bytes(h, geometry, sizeof(geometry));
+	}
+	return h;
+}
+
+/* The position of a signal within its message, for comparing references
+ * to a multiplexor by place instead of by name */
+static size_t signal_index(can_msg_t *msg, const char *name)
+{
+	assert(msg);
+	for (size_t i = 0; name && i < msg->signal_count; i++)
+		if (!strcmp(msg->sigs[i]->name, name))
+			return i;
+	return SIZE_MAX;
+}
+
+static bool signal_layout_equal(can_msg_t *ma, signal_t *a, can_msg_t *mb, signal_t *b, dbc2c_options_t *copts)
+{
+	assert(ma);
+	assert(a);
+	assert(mb);
+	assert(b);
+	assert(copts);
+	if (!(a->start_bit == b->start_bit
+		&& a->bit_length == b->bit_length
+		&& a->endianess == b->endianess
+		&& a->is_signed == b->is_signed
+		&& a->is_floating == b->is_floating
+		&& a->scaling == b->scaling
+		&& a->offset == b->offset
+		&& a->is_multiplexor == b->is_multiplexor
+		&& a->is_multiplexed == b->is_multiplexed
+		&& a->switchval == b->switchval
+		&& a->mux_range_count == b->mux_range_count
+		&& signal_index(ma, a->multiplexor_name) == signal_index(mb, b->multiplexor_name)
+		&& signal_in_union(ma, a, copts) == signal_in_union(mb, b, copts)))
+		return false;
+	if (a->mux_range_count && memcmp(a->mux_ranges, b->mux_ranges, a->mux_range_count * sizeof(*a->mux_ranges)))
+		return false;
+	size_t ia = 0, ib = 0; /* the same place in arrays of the same size */
+	const signal_array_t *aa = signal_array(ma, a, copts, &ia), *ab = signal_array(mb, b, copts, &ib);
+	if (!aa || !ab)
+		return !aa && !ab;
+	return ia == ib && aa->count == ab->count;
+}
+
+static bool msg_layout_equal(can_msg_t *a, can_msg_t *b, dbc2c_options_t *copts)
+{
+	assert(a);
+	assert(b);
+	assert(copts);
+	if (a->dlc != b->dlc || a->signal_count != b->signal_count)
+		return false;
+	if (msg_generate_pack(a, copts) != msg_generate_pack(b, copts) || msg_generate_unpack(a, copts) != msg_generate_unpack(b, copts))
+		return false;
+	for (size_t i = 0; i < a->signal_count; i++)
+		if (!signal_layout_equal(a, a->sigs[i], b, b->sigs[i], copts))
+			return false;
+	return true;
+}
+
+typedef struct {
+	uint64_t hash;
+	size_t index;
+} layout_key_t;
+
+static int layout_key_compare(const void *a, const void *b)
+{
+	assert(a);
+	assert(b);
+	const layout_key_t *x = a, *y = b;
+	if (x->hash != y->hash)
+		return x->hash < y->hash ? -1 : 1;
+	return x->index < y->index ? -1 : x->index > y->index ? 1 : 0;
+}
+
+/* Point each message at the first message, in identifier order, with the
+ * same layout; messages that have no twin are left alone */
+static void msg_layouts(dbc_t *dbc, dbc2c_options_t *copts)
+{
+	assert(dbc);
+	assert(copts);
+	layout_key_t *keys = allocate(sizeof(*keys) * (dbc->message_count + 1));
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		dbc->messages[i]->layout = NULL;
+		keys[i].hash = msg_layout_hash(dbc->messages[i]);
+		keys[i].index = i;
+	}
+	qsort(keys, dbc->message_count, sizeof(*keys), layout_key_compare);
+	size_t shared = 0, layouts = 0;
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *first = dbc->messages[keys[i].index];
+		if (first->layout || !first->signal_count)
+			continue;
+		for (size_t j = i + 1; j < dbc->message_count && keys[j].hash == keys[i].hash; j++) {
+			can_msg_t *msg = dbc->messages[keys[j].index];
+			if (msg->layout || !msg_layout_equal(first, msg, copts))
+				continue;
+			debug("%s shares the layout of %s", msg->name, first->name);
+			layouts += !first->layout;
+			first->layout = first;
+			msg->layout = first;
+			shared++;
+		}
+	}
+	if (shared)
+		note("%zu messages share the pack/unpack functions of %zu others", shared, layouts);
+	free(keys);
+}
+
+static bool layout_generate(dbc_t *dbc, can_msg_t *layout, bool pack, dbc2c_options_t *copts)
+{
+	assert(dbc);
+	assert(layout);
+	assert(copts);
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = dbc->messages[i];
+		if (msg->layout == layout && (pack ? msg_generate_pack(msg, copts) : msg_generate_unpack(msg, copts)))
+			return true;
+	}
+	return false;
+}
+
+/* the shared functions, named after the first message with the layout */
+static int layouts2c(dbc_t *dbc, FILE *c, const char *god, dbc2c_options_t *copts)
+{
+	assert(dbc);
+	assert(c);
+	assert(god);
+	assert(copts);
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = dbc->messages[i];
+		if (msg->layout != msg)
+			continue;
+		char name[MAX_NAME_LENGTH] = {0};
+		make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+		const unsigned swap = msg_swap_width(msg);
+		const bool wire_used = msg_wire_used(msg);
+		const bool bmi2 = msg_bmi2_variant(msg, swap, wire_used, copts);
+		layout_switch_open(c, dbc, msg, god, copts);
+		if (layout_generate(dbc, msg, true, copts)) {
+			if (bmi2 && msg_pack(msg, c, name, swap, wire_used, true, true, god, copts) < 0)
+				return -1;
+			if (msg_pack(msg, c, name, swap, wire_used, false, true, god, copts) < 0)
+				return -1;
+		}
+		if (layout_generate(dbc, msg, false, copts)) {
+			if (bmi2 && msg_unpack(msg, c, name, swap, wire_used, true, true, god, copts) < 0)
+				return -1;
+			if (msg_unpack(msg, c, name, swap, wire_used, false, true, god, copts) < 0)
+				return -1;
+		}
+		msg_switch_close(c, copts);
+	}
+	return 0;
+}
+
+/* A shared conversion is needed if any message that calls it is switched on */
+static void conversion_switch_open(FILE *o, dbc_t *dbc, can_msg_t *layout, size_t signal, const char *god, dbc2c_options_t *copts)
+{
+	assert(o);
+	assert(dbc);
+	assert(layout);
+	assert(god);
+	assert(copts);
+	if (!copts->use_msg_switches)
+		return;
+	fputs("#if", o);
+	for (size_t i = 0, n = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = dbc->messages[i];
+		if (msg->layout != layout || signal_shared_conversion(msg, msg->sigs[signal]) != layout->sigs[signal])
+			continue;
+		char sw[MAX_NAME_LENGTH * 2] = {0};
+		msg_switch_name(sw, sizeof(sw), msg, god, copts);
+		fprintf(o, "%s%s", n++ ? " || " : " ", sw);
+	}
+	fputs("\n", o);
+}
+
+/* The conversions shared by the messages with the layout of 'layout', or
+ * without 'dbc' only their prototypes. They are static functions, static
+ * inline in the header with '-H', unless the messages are split over several
+ * files (see '-m') and the main C file defines them for all of them. */
+static int layout2raw(dbc_t *dbc, can_msg_t *layout, FILE *o, const char *god, size_t *budget, dbc2c_options_t *copts)
+{
+	assert(layout);
+	assert(o);
+	assert(copts);
+	const bool prototype = !dbc;
+	const char *linkage = copts->split ? "" : copts->header_only ? "static inline " : "static ";
+	for (size_t i = 0; i < layout->signal_count; i++) {
+		signal_t *sig = layout->sigs[i];
+		size_t index = 0;
+		const signal_array_t *a = signal_array(layout, sig, copts, &index);
+		if ((a && index) || !signal_shared_conversion(layout, sig))
+			continue;
+		const char *raw = determine_type(sig->bit_length, sig->is_signed, sig->is_floating);
+		const char *type = sig->scaling != 1.0 || sig->offset != 0.0 ? "double" : raw;
+		char fname[MAX_NAME_LENGTH * 2] = {0};
+		if (!prototype)
+			conversion_switch_open(o, dbc, layout, i, god, copts);
+		if (msg_generate_unpack(layout, copts)) {
+			signal_raw_helper(layout, sig, true, fname, sizeof(fname), copts);
+			fprintf(o, "%sint %s(%s raw, %s *out)%s", prototype ? "" : linkage, fname, raw,
+					copts->use_doubles_for_encoding ? "double" : type, prototype ? ";\n" : " {\n");
+			if (!prototype && signal2decode_body(sig, "raw", type, o, budget) < 0)
+				return -1;
+		}
+		if (msg_generate_pack(layout, copts)) {
+			type = signal_encode_type(sig, copts);
+			signal_raw_helper(layout, sig, false, fname, sizeof(fname), copts);
+			fprintf(o, "%sint %s(%s in, %s *raw)%s", prototype ? "" : linkage, fname, type, raw, prototype ? ";\n" : " {\n");
+			if (!prototype && signal2encode_scaling(sig, o, "*raw = 0;", !strcmp(type, "double")) < 0)
+				return -1;
+			if (!prototype)
+				fputs("\t*raw = in;\n\treturn 0;\n}\n\n", o);
+		}
+		if (!prototype)
+			msg_switch_close(o, copts);
+	}
+	return 0;
+}
+
+static int layouts2raw(dbc_t *dbc, FILE *o, const char *god, size_t *budget, dbc2c_options_t *copts)
+{
+	assert(dbc);
+	assert(o);
+	assert(god);
+	assert(copts);
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = dbc->messages[i];
+		if (msg->layout == msg && layout2raw(dbc, msg, o, god, budget, copts) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/* With '-q' the unpack function of a message is a writer of its sequence
+ * counter, which is odd while the message is written, and the pack function
+ * a reader, which retries until it has packed the message from values that
+ * were not being written, as the 'get_group' functions do. */
+static int msg_sequence_wrappers(can_msg_t *msg, FILE *c, const char *name, const char *god, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(c);
+	assert(name);
+	assert(god);
+	assert(copts);
+	if (!copts->use_sequence_counter)
+		return 0;
+	if (msg_generate_pack(msg, copts)) {
+		if (msg_is_cold(msg))
+			fputs("DBCC_COLD ", c);
+		print_function_name(c, "pack", name, " {\n", false, "uint64_t", false, god, copts->split);
+		fputs("\tunsigned seq = 0;\n\tint r = 0;\n\tdo {\n", c);
+		fprintf(c, "\t\tseq = o->%s_seq;\n\t\tDBCC_SEQ_BARRIER();\n", name);
+		fprintf(c, "\t\tr = pack_body_%s(o, data);\n", name);
+		fprintf(c, "\t\tDBCC_SEQ_BARRIER();\n\t} while ((seq & 1u) || seq != o->%s_seq);\n", name);
+		fputs("\treturn r;\n}\n\n", c);
+	}
+	if (msg_generate_unpack(msg, copts)) {
+		if (msg_is_cold(msg))
+			fputs("DBCC_COLD ", c);
+		print_function_name(c, "unpack", name, " {\n", true, "uint64_t", true, god, copts->split);
+		fputs("\tint r = 0;\n", c);
+		fprintf(c, "\tDBCC_SEQ_WRITE(o->%s_seq, r = unpack_body_%s(o, data, dlc, time_stamp));\n", name, name);
+		fputs("\treturn r;\n}\n\n", c);
+	}
+	return 0;
+}
+
+static int msg_layout_wrappers(can_msg_t *msg, FILE *c, const char *name, const char *god, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(msg->layout);
+	assert(c);
+	assert(name);
+	assert(god);
+	assert(copts);
+	char layout[MAX_NAME_LENGTH] = {0};
+	make_name(layout, MAX_NAME_LENGTH, msg->layout->name, msg->layout->id, copts);
+	if (msg->layout != msg) /* the members are the same, the structures are copied */
+		fprintf(c, "DBCC_STATIC_ASSERT(sizeof(%s_t) == sizeof(%s_t), %s_layout);\n\n", name, layout, name);
+	if (msg_generate_pack(msg, copts)) {
+		if (msg_is_cold(msg))
+			fputs("DBCC_COLD ", c);
+		print_function_name(c, msg_body_prefix(false, copts), name, " {\n", false, "uint64_t", false, god, !copts->use_sequence_counter && copts->split);
+		if (copts->generate_asserts)
+			fprintf(c, "\tassert(o);\n\tassert(data);\n");
+		fprintf(c, "\tif (pack_layout_%s(&o->%s, data) < 0)\n\t\treturn -1;\n", layout, name);
+		fprintf(c, "\to->%s_tx = 1;\n\treturn 0;\n}\n\n", name);
+	}
+	if (msg_generate_unpack(msg, copts)) {
+		if (msg_is_cold(msg))
+			fputs("DBCC_COLD ", c);
+		print_function_name(c, msg_body_prefix(true, copts), name, " {\n", true, "uint64_t", true, god, !copts->use_sequence_counter && copts->split);
+		if (copts->generate_asserts)
+			fprintf(c, "\tassert(o);\n");
+		fprintf(c, "\tif (unpack_layout_%s(&o->%s, data, dlc) < 0)\n\t\treturn -1;\n", layout, name);
+		fprintf(c, "\to->%s_rx = 1;\n\to->%s_time_stamp_rx = time_stamp;\n\treturn 0;\n}\n\n", name, name);
+	}
+	return 0;
+}
+
+/* Functions that insert signals into packed frames, with '-H' they are
+ * not inlined, as they need the byte swapping and floating point helpers
+ * that are kept in the implementation section */
+static int msg2repack(can_msg_t *msg, FILE *o, bool header, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(o);
+	assert(copts);
+	if (!copts->generate_repack || !msg_generate_pack(msg, copts))
+		return 0;
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		if (signal2repack(msg->id, msg->sigs[i], o, header, copts) < 0)
+			return -1;
+		if (signal2patch(msg->id, msg->sigs[i], o, header, copts) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/* The signal accessors; prototypes, or with '-H' their static inline
+ * definitions so they can be inlined into every module that uses them. */
+static int msg2accessors(can_msg_t *msg, FILE *o, const char *name, bool header, const char *god, size_t *budget, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(o);
+	assert(name);
+	assert(god);
+	assert(copts);
+	if (msg2scaling(msg, name, o, header, god, budget, copts) < 0)
+		return -1;
+	if (msg2groups(msg, o, name, header, god, copts) < 0)
+		return -1;
+	return msg2repack(msg, o, header || copts->header_only, copts);
+}
+
+static int msg2c_functions(can_msg_t *msg, FILE *c, size_t *budget, dbc2c_options_t *copts, char *god)
+{
+	assert(msg);
+	assert(c);
+	assert(budget);
+	assert(copts);
+	assert(god);
+	char name[MAX_NAME_LENGTH] = {0};
+	make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+	const unsigned swap = msg_swap_width(msg);
+	const bool wire_used = msg_wire_used(msg);
+
+	/* sanity checks against messages should go here, we could check for;
+	 * - odd min/max values given scaling
+	 * - duplicate signals and messages
+	 * They really should go into a semantic analysis phase after reading
+	 * in the DBC file and parsing it. Oh Well. */
+	msg_dlc_check(msg);
+	msg_overlap_check(msg);
+	msg_range_check(msg);
+
+	const bool generate = msg->layout ? msg->layout == msg : (msg_generate_pack(msg, copts) || msg_generate_unpack(msg, copts));
+	if (generate && msg_overlay_asserts(msg, c, name, copts) < 0)
+		return -1;
+
+	const bool bmi2 = msg_bmi2_variant(msg, swap, wire_used, copts) && !msg->layout;
+
+	if (msg->layout && msg_layout_wrappers(msg, c, name, god, copts) < 0)
+		return -1;
+
+	if (msg_generate_pack(msg, copts) && bmi2 && msg_pack(msg, c, name, swap, wire_used, true, false, god, copts) < 0)
+		return -1;
+
+	if (msg_generate_pack(msg, copts) && !msg->layout && msg_pack(msg, c, name, swap, wire_used, false, false, god, copts) < 0)
+		return -1;
+
+	if (msg_generate_unpack(msg, copts) && bmi2 && msg_unpack(msg, c, name, swap, wire_used, true, false, god, copts) < 0)
+		return -1;
+
+	if (msg_generate_unpack(msg, copts) && !msg->layout && msg_unpack(msg, c, name, swap, wire_used, false, false, god, copts) < 0)
+		return -1;
+
+	if (msg_sequence_wrappers(msg, c, name, god, copts) < 0)
+		return -1;
+
+	if (!copts->header_only && msg2accessors(msg, c, name, false, god, budget, copts) < 0)
+		return -1;
+
+	if (copts->header_only && msg2repack(msg, c, false, copts) < 0)
+		return -1;
+
+	if (copts->generate_format && msg_format(msg, c, name, god, copts) < 0)
+		return -1;
+
+	if (copts->generate_print && msg_print(msg, c, name, god, copts) < 0)
+		return -1;
+
+	if (copts->generate_serialize && msg_serialize(msg, c, name, god, copts) < 0)
+		return -1;
+
+	return 0;
+}
+
+static int msg2c(can_msg_t *msg, FILE *c, size_t *budget, dbc2c_options_t *copts, char *god)
+{
+	assert(msg);
+	assert(c);
+	assert(copts);
+	assert(god);
+	msg_switch_open(c, msg, god, copts);
+	const int r = msg2c_functions(msg, c, budget, copts, god);
+	msg_switch_close(c, copts);
+	return r;
+}
+
+static int msg2h_functions(can_msg_t *msg, FILE *h, size_t *budget, dbc2c_options_t *copts, const char *god)
+{
+	assert(msg);
+	assert(h);
+	assert(budget);
+	assert(copts);
+	assert(god);
+	char name[MAX_NAME_LENGTH] = {0};
+	make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+
+	if (copts->header_only)
+		return msg2accessors(msg, h, name, false, god, budget, copts);
+	if (msg2accessors(msg, h, name, true, god, NULL, copts) < 0)
+		return -1;
+	fputs("\n\n", h);
+	return 0;
+}
+
+static int msg2h(can_msg_t *msg, FILE *h, size_t *budget, dbc2c_options_t *copts, const char *god)
+{
+	assert(msg);
+	assert(h);
+	assert(copts);
+	assert(god);
+	msg_switch_open(h, msg, god, copts);
+	const int r = msg2h_functions(msg, h, budget, copts, god);
+	msg_switch_close(h, copts);
+	return r;
+}
+
+/* Byte swapping uses the compiler intrinsics where they are known to exist,
+ * these compile to a single instruction (bswap, rev), the portable versions
+ * are used otherwise or if DBCC_NO_BUILTIN_BSWAP is defined. The frame is
+ * passed around as an integer value, not as bytes in memory, so the host
+ * byte order does not matter here; a big endian host could skip the swap of
+ * Motorola signals only if the frame were handed over as bytes. */
+static const char *cfunctions =
+"#ifndef DBCC_NO_BUILTIN_BSWAP\n"
+"#if defined(__clang__) || (defined(__GNUC__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 8)))\n"
+"#define DBCC_BSWAP16(x) __builtin_bswap16(x)\n"
+"#define DBCC_BSWAP32(x) __builtin_bswap32(x)\n"
+"#define DBCC_BSWAP64(x) __builtin_bswap64(x)\n"
+"#elif defined(_MSC_VER)\n"
+"#include <stdlib.h>\n"
+"#define DBCC_BSWAP16(x) _byteswap_ushort(x)\n"
+"#define DBCC_BSWAP32(x) _byteswap_ulong(x)\n"
+"#define DBCC_BSWAP64(x) _byteswap_uint64(x)\n"
+"#endif\n"
+"#endif\n\n"
+"static inline uint64_t reverse_byte_order(uint64_t x) {\n"
+"#ifdef DBCC_BSWAP64\n"
+"\treturn DBCC_BSWAP64(x);\n"
+"#else\n"
+"\tx = (x & 0x00000000FFFFFFFF) << 32 | (x & 0xFFFFFFFF00000000) >> 32;\n"
+"\tx = (x & 0x0000FFFF0000FFFF) << 16 | (x & 0xFFFF0000FFFF0000) >> 16;\n"
+"\tx = (x & 0x00FF00FF00FF00FF) << 8  | (x & 0xFF00FF00FF00FF00) >> 8;\n"
+"\treturn x;\n"
+"#endif\n"
+"}\n\n"
+"static inline uint32_t reverse_byte_order32(uint32_t x) {\n"
+"#ifdef DBCC_BSWAP32\n"
+"\treturn DBCC_BSWAP32(x);\n"
+"#else\n"
+"\tx = (x & 0x0000FFFF) << 16 | (x & 0xFFFF0000) >> 16;\n"
+"\tx = (x & 0x00FF00FF) << 8  | (x & 0xFF00FF00) >> 8;\n"
+"\treturn x;\n"
+"#endif\n"
+"}\n\n"
+"static inline uint16_t reverse_byte_order16(uint16_t x) {\n"
+"#ifdef DBCC_BSWAP16\n"
+"\treturn DBCC_BSWAP16(x);\n"
+"#else\n"
+"\treturn (uint16_t)((x << 8) | (x >> 8));\n"
+"#endif\n"
+"}\n\n";
+/* The frame can be copied straight to and from the message structures on a
+ * little endian host, define DBCC_NO_OVERLAY to always use the shift and mask
+ * path, or DBCC_LITTLE_ENDIAN if it is not detected for your compiler. */
+static const char *cfunctions_overlay_only =
+"#if !defined(DBCC_LITTLE_ENDIAN) && !defined(DBCC_NO_OVERLAY)\n"
+"#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)\n"
+"#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__\n"
+"#define DBCC_LITTLE_ENDIAN\n"
+"#endif\n"
+"#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64) || defined(_M_ARM) || defined(_M_ARM64))\n"
+"#define DBCC_LITTLE_ENDIAN\n"
+"#endif\n"
+"#endif\n\n";
+
+/* Checks of the structure layouts the overlay paths and the functions shared
+ * between messages rely on */
+static const char *cfunctions_static_assert =
+"#ifndef DBCC_STATIC_ASSERT\n"
+"#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)\n"
+"#define DBCC_STATIC_ASSERT(EXPR, TAG) _Static_assert(EXPR, #TAG)\n"
+"#else\n"
+"#define DBCC_STATIC_ASSERT(EXPR, TAG) typedef char dbcc_static_assert_ ## TAG[(EXPR) ? 1 : -1]\n"
+"#endif\n"
+"#endif\n\n";
+/* BMI2 (PEXT/PDEP) is used for x86-64 with GCC or clang if the CPU supports
+ * it, checked once at run time, or always if compiled with -mbmi2 (or a
+ * -march that has it). Define DBCC_NO_BMI2 to turn it off. */
+static const char *cfunctions_bmi2_only =
+"#if !defined(DBCC_NO_BMI2) && (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)\n"
+"#include <immintrin.h>\n"
+"#define DBCC_BMI2\n"
+"#define DBCC_BMI2_TARGET __attribute__((target(\"bmi2\")))\n\n"
+"static inline int dbcc_has_bmi2(void) {\n"
+"#ifdef __BMI2__\n"
+"\treturn 1;\n"
+"#else\n"
+"\tstatic int has = -1;\n"
+"\tif (has < 0)\n"
+"\t\thas = !!__builtin_cpu_supports(\"bmi2\");\n"
+"\treturn has;\n"
+"#endif\n"
+"}\n"
+"#endif\n\n";
+
+static const char *cfunctions_print_only =
+"static inline int print_helper(int r, int print_return_value) {\n"
+"\treturn ((r >= 0) && (print_return_value >= 0)) ? r + print_return_value : -1;\n"
+"}\n\n";
+
+/* Formatting routines that do not need <stdio.h>, they keep counting when
+ * the buffer is full so the caller can tell how much space was needed. */
+static const char *cfunctions_format_only =
+"static inline size_t fmt_char(char *buf, size_t len, size_t at, char ch) {\n"
+"\tif ((at + 1) < len)\n"
+"\t\tbuf[at] = ch;\n"
+"\treturn at + 1;\n"
+"}\n\n"
+"static inline size_t fmt_str(char *buf, size_t len, size_t at, const char *s) {\n"
+"\twhile (*s)\n"
+"\t\tat = fmt_char(buf, len, at, *s++);\n"
+"\treturn at;\n"
+"}\n\n"
+"static inline size_t fmt_u64(char *buf, size_t len, size_t at, uint64_t u) {\n"
+"\tchar t[20];\n"
+"\tsize_t i = 0;\n"
+"\tdo {\n"
+"\t\tt[i++] = '0' + (u % 10);\n"
+"\t\tu /= 10;\n"
+"\t} while (u);\n"
+"\twhile (i)\n"
+"\t\tat = fmt_char(buf, len, at, t[--i]);\n"
+"\treturn at;\n"
+"}\n\n"
+"static inline size_t fmt_i64(char *buf, size_t len, size_t at, int64_t i) {\n"
+"\tif (i < 0)\n"
+"\t\treturn fmt_u64(buf, len, fmt_char(buf, len, at, '-'), 0uLL - (uint64_t)i);\n"
+"\treturn fmt_u64(buf, len, at, i);\n"
+"}\n\n"
+"static inline size_t fmt_fixed(char *buf, size_t len, size_t at, double d, unsigned decimals) {\n"
+"\tuint64_t scale = 1;\n"
+"\tfor (unsigned i = 0; i < decimals; i++)\n"
+"\t\tscale *= 10;\n"
+"\tif (d != d)\n"
+"\t\treturn fmt_str(buf, len, at, \"nan\");\n"
+"\tif (d < 0) {\n"
+"\t\tat = fmt_char(buf, len, at, '-');\n"
+"\t\td = -d;\n"
+"\t}\n"
+"\tif (d == (d * 2.0) && d != 0.0)\n"
+"\t\treturn fmt_str(buf, len, at, \"inf\");\n"
+"\tif (d >= 1e19) { /* too big for fixed point */\n"
+"\t\tuint64_t e = 0;\n"
+"\t\tfor (; d >= 1e18; e++)\n"
+"\t\t\td /= 10.0;\n"
+"\t\tat = fmt_u64(buf, len, at, d);\n"
+"\t\treturn fmt_u64(buf, len, fmt_char(buf, len, at, 'e'), e);\n"
+"\t}\n"
+"\tfor (; decimals && (d * scale) >= 1e19; decimals--) /* drop digits that do not fit */\n"
+"\t\tscale /= 10;\n"
+"\tconst uint64_t fixed = (d * scale) + 0.5;\n"
+"\tat = fmt_u64(buf, len, at, fixed / scale);\n"
+"\tif (decimals) {\n"
+"\t\tat = fmt_char(buf, len, at, '.');\n"
+"\t\tfor (uint64_t s = scale / 10, f = fixed % scale; s; s /= 10)\n"
+"\t\t\tat = fmt_char(buf, len, at, '0' + ((f / s) % 10));\n"
+"\t}\n"
+"\treturn at;\n"
+"}\n\n";
+
+static const char *cfunctions_serialize_only =
+"static inline size_t fmt_json_fixed(char *buf, size_t len, size_t at, double d, unsigned decimals) {\n"
+"\tif (d != d || (d == (d * 2.0) && d != 0.0)) /* JSON has no NaN or infinity */\n"
+"\t\treturn fmt_str(buf, len, at, \"null\");\n"
+"\treturn fmt_fixed(buf, len, at, d, decimals);\n"
+"}\n\n"
+"static inline size_t ser_le(char *buf, size_t len, size_t at, uint64_t v, unsigned bytes) {\n"
+"\tfor (unsigned i = 0; i < bytes; i++, at++, v >>= 8)\n"
+"\t\tif (at < len)\n"
+"\t\t\tbuf[at] = (char)(v & 0xFF);\n"
+"\treturn at;\n"
+"}\n\n";
+
+static int message_compare_function(const void *a, const void *b)
+{
+	assert(a);
+	assert(b);
+	can_msg_t *ap = *((can_msg_t**)a);
+	can_msg_t *bp = *((can_msg_t**)b);
+	if (ap->id <  bp->id) return -1;
+	if (ap->id == bp->id) return  0;
+	if (ap->id >  bp->id) return  1;
+	return 0;
+}
+
+static int signal_compare_function(const void *a, const void *b)
+{
+	assert(a);
+	assert(b);
+	signal_t *ap = *((signal_t**)a);
+	signal_t *bp = *((signal_t**)b);
+	if (ap->bit_length <  bp->bit_length) return  1;
+	if (ap->bit_length == bp->bit_length) return  0;
+	if (ap->bit_length >  bp->bit_length) return -1;
+	return 0;
+}
+
+static int signal_start_compare(const void *a, const void *b)
+{
+	assert(a);
+	assert(b);
+	signal_t *ap = *((signal_t**)a);
+	signal_t *bp = *((signal_t**)b);
+	if (ap->start_bit < bp->start_bit) return -1;
+	if (ap->start_bit > bp->start_bit) return  1;
+	return 0;
+}
+
+/* If every signal can be copied straight out of the frame, they follow each
+ * other without gaps and each is aligned to its own size, then laying the
+ * structure out in frame order instead of by size gives the same layout
+ * without any padding; the whole message becomes a single memcpy on a little
+ * endian host. Returns true and reorders the signals if so. */
+static bool msg_wire_layout(can_msg_t *msg, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(copts);
+	if (!(copts->use_overlay) || msg->signal_count < 2 || find_multiplexor(msg))
+		return false;
+	signal_t **sigs = allocate(msg->signal_count * sizeof(*sigs));
+	memcpy(sigs, msg->sigs, msg->signal_count * sizeof(*sigs));
+	qsort(sigs, msg->signal_count, sizeof(*sigs), signal_start_compare);
+	bool wire = true;
+	for (size_t i = 0; wire && i < msg->signal_count; i++) {
+		signal_t *sig = sigs[i];
+		const unsigned offset = (sig->start_bit - sigs[0]->start_bit) / 8;
+		if (!signal_is_overlay_candidate(sig) || signal_in_array(msg, sig, copts))
+			wire = false;
+		else if (offset % (sig->bit_length / 8))
+			wire = false;
+		else if (i && sig->start_bit != (sigs[i - 1]->start_bit + sigs[i - 1]->bit_length))
+			wire = false;
+	}
+	if (wire)
+		memcpy(msg->sigs, sigs, msg->signal_count * sizeof(*sigs));
+	free(sigs);
+	return wire;
+}
+
+/* Call the unpack function of a message from within 'dispatch_message',
+ * setting 'r'. With '-q' the unpack function updates the sequence counter
+ * itself, see msg_sequence_wrappers. */
+static int msg_unpack_call(FILE *c, const char *name, dbc2c_options_t *copts)
+{
+	assert(c);
+	assert(name);
+	assert(copts);
+	return fprintf(c, "\t\tr = unpack_%s(o, data, dlc, time_stamp);\n", name);
+}
+
+/* With a profile 'unpack_message' tests the hottest of 'msgs' (see
+ * msgs_by_profile) before its switch, until they cover PROFILE_HOT_SHARE of
+ * the frames. Returns the index of the first message left to the switch,
+ * and the number of messages tested in 'tested'. */
+static size_t msgs_pre_tested(dbc_t *dbc, can_msg_t **msgs, size_t *tested, dbc2c_options_t *copts)
+{
+	assert(dbc);
+	assert(msgs);
+	assert(copts);
+	size_t first = 0, n = 0;
+	double share = 0;
+	for (; copts->profile && first < dbc->message_count; first++) {
+		can_msg_t *msg = msgs[first];
+		if (!msg_generate_unpack(msg, copts))
+			continue;
+		if (n >= PROFILE_HOT_MAX || share >= PROFILE_HOT_SHARE || msg->share <= 0)
+			break;
+		share += msg->share;
+		n++;
+	}
+	if (tested)
+		*tested = n;
+	return first;
+}
+
+static int switch_function(FILE *c, dbc_t *dbc, char *function, bool unpack,
+		bool prototype, const char *datatype, bool dlc, const char *god, dbc2c_options_t *copts)
+{
+	assert(c);
+	assert(dbc);
+	assert(function);
+	assert(god);
+	assert(copts);
+	fprintf(c, "int %s_message(can_obj_%s_t *o, const unsigned long id, %s %sdata%s)",
+			function, god, datatype, unpack ? "" : "*",
+			dlc ? ", uint8_t dlc, dbcc_time_stamp_t time_stamp" : "");
+	if (prototype)
+		return fprintf(c, ";\n");
+	fprintf(c, " {\n");
+	if (copts->generate_asserts) {
+		fprintf(c, "\tassert(o);\n");
+		fprintf(c, "\tassert(id < (1ul << 29)); /* 29-bit CAN ID is largest possible */\n");
+		if (dlc)
+			fprintf(c, "\tassert(dlc <= 8);         /* Maximum of 8 bytes in a CAN packet */\n");
+	}
+
+	size_t cases = 0;
+	for (size_t i = 0; i < dbc->message_count; i++)
+		if (unpack ? msg_generate_unpack(dbc->messages[i], copts) : msg_generate_pack(dbc->messages[i], copts))
+			cases++;
+	if (!cases || copts->use_msg_switches) /* every message may be switched off */
+		fprintf(c, "\tDBCC_UNUSED(o);\n\tDBCC_UNUSED(data);\n%s", dlc ? "\tDBCC_UNUSED(dlc);\n\tDBCC_UNUSED(time_stamp);\n" : "");
+
+	/* With a profile the most frequently received messages are tested
+	 * before the switch, the rest of the cases follow hottest first. */
+	can_msg_t **msgs = msgs_by_profile(dbc, copts);
+	const size_t first = unpack ? msgs_pre_tested(dbc, msgs, NULL, copts) : 0;
+	for (size_t i = 0; i < first; i++) {
+		can_msg_t *msg = msgs[i];
+		if (!msg_generate_unpack(msg, copts))
+			continue;
+		char name[MAX_NAME_LENGTH] = {0};
+		make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+		msg_switch_open(c, msg, god, copts);
+		fprintf(c, "\tif (id == 0x%03lx) /* %.2f%% of profiled frames */\n\t\treturn unpack_%s(o, data, dlc, time_stamp);\n",
+				msg->id, msg->share * 100.0, name);
+		msg_switch_close(c, copts);
+	}
+
+	fprintf(c, "\tswitch (id) {\n");
+	for (size_t i = first; i < dbc->message_count; i++) {
+		can_msg_t *msg = msgs[i];
+		if (!(unpack ? msg_generate_unpack(msg, copts) : msg_generate_pack(msg, copts)))
+			continue;
+		char name[MAX_NAME_LENGTH] = {0};
+		make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+		msg_switch_open(c, msg, god, copts);
+		fprintf(c, "\tcase 0x%03lx: return %s_%s(o, data%s);\n",
+				msg->id,
+				function,
+				name,
+				dlc ? ", dlc, time_stamp" : "");
+		msg_switch_close(c, copts);
+	}
+	fprintf(c, "\tdefault: break; \n\t}\n");
+	free(msgs);
+	return fprintf(c, "\treturn -1; \n}\n\n");
+}
+
+static int switch_function_print(FILE *c, dbc_t *dbc, bool prototype, const char *god, dbc2c_options_t *copts)
+{
+	assert(c);
+	assert(dbc);
+	assert(god);
+	assert(copts);
+	fprintf(c, "int print_message(const can_obj_%s_t *o, const unsigned long id, FILE *output)", god);
+	if (prototype)
+		return fprintf(c, ";\n");
+	fprintf(c, " {\n");
+	if (copts->generate_asserts) {
+		fprintf(c, "\tassert(o);\n");
+		fprintf(c, "\tassert(id < (1ul << 29)); /* 29-bit CAN ID is largest possible */\n");
+		fprintf(c, "\tassert(output);\n");
+	}
+	if (copts->use_msg_switches)
+		fprintf(c, "\tDBCC_UNUSED(o);\n\tDBCC_UNUSED(output);\n");
+
+	fprintf(c, "\tswitch (id) {\n");
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = dbc->messages[i];
+		char name[MAX_NAME_LENGTH] = {0};
+		make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+		msg_switch_open(c, msg, god, copts);
+		fprintf(c, "\tcase 0x%03lx: return print_%s(o, output);\n", msg->id, name);
+		msg_switch_close(c, copts);
+	}
+	fprintf(c, "\tdefault: break; \n\t}\n");
+	return fprintf(c, "\treturn -1; \n}\n\n");
+}
+
+static int switch_function_format(FILE *c, dbc_t *dbc, bool prototype, const char *god, dbc2c_options_t *copts)
+{
+	assert(c);
+	assert(dbc);
+	assert(god);
+	assert(copts);
+	fprintf(c, "int format_message(const can_obj_%s_t *o, const unsigned long id, char *buf, size_t len)", god);
+	if (prototype)
+		return fprintf(c, ";\n");
+	fprintf(c, " {\n");
+	if (copts->generate_asserts) {
+		fprintf(c, "\tassert(o);\n");
+		fprintf(c, "\tassert(id < (1ul << 29)); /* 29-bit CAN ID is largest possible */\n");
+		fprintf(c, "\tassert(buf || len == 0);\n");
+	}
+	if (!dbc->message_count || copts->use_msg_switches)
+		fprintf(c, "\tDBCC_UNUSED(o);\n\tDBCC_UNUSED(buf);\n\tDBCC_UNUSED(len);\n");
+
+	fprintf(c, "\tswitch (id) {\n");
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = dbc->messages[i];
+		char name[MAX_NAME_LENGTH] = {0};
+		make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+		msg_switch_open(c, msg, god, copts);
+		fprintf(c, "\tcase 0x%03lx: return format_%s(o, buf, len);\n", msg->id, name);
+		msg_switch_close(c, copts);
+	}
+	fprintf(c, "\tdefault: break; \n\t}\n");
+	return fprintf(c, "\treturn -1; \n}\n\n");
+}
+
+static int switch_function_serialize(FILE *c, dbc_t *dbc, bool prototype, const char *god, dbc2c_options_t *copts)
+{
+	assert(c);
+	assert(dbc);
+	assert(god);
+	assert(copts);
+	fprintf(c, "int serialize_message(const can_obj_%s_t *o, const unsigned long id, dbcc_serialize_e format, char *buf, size_t len)", god);
+	if (prototype)
+		return fprintf(c, ";\n");
+	fprintf(c, " {\n");
+	if (copts->generate_asserts) {
+		fprintf(c, "\tassert(o);\n");
+		fprintf(c, "\tassert(id < (1ul << 29)); /* 29-bit CAN ID is largest possible */\n");
+		fprintf(c, "\tassert(buf || len == 0);\n");
+	}
+	if (!dbc->message_count || copts->use_msg_switches)
+		fprintf(c, "\tDBCC_UNUSED(o);\n\tDBCC_UNUSED(format);\n\tDBCC_UNUSED(buf);\n\tDBCC_UNUSED(len);\n");
+
+	fprintf(c, "\tswitch (id) {\n");
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = dbc->messages[i];
+		char name[MAX_NAME_LENGTH] = {0};
+		make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+		msg_switch_open(c, msg, god, copts);
+		fprintf(c, "\tcase 0x%03lx:\n", msg->id);
+		fprintf(c, "\t\tswitch (format) {\n");
+		fprintf(c, "\t\tcase DBCC_SERIALIZE_JSON_E: return serialize_json_%s(o, buf, len);\n", name);
+		fprintf(c, "\t\tcase DBCC_SERIALIZE_CSV_E:  return serialize_csv_%s(o, buf, len);\n", name);
+		fprintf(c, "\t\tcase DBCC_SERIALIZE_BIN_E:  return serialize_bin_%s(o, buf, len);\n", name);
+		fprintf(c, "\t\t}\n\t\tbreak;\n");
+		msg_switch_close(c, copts);
+	}
+	fprintf(c, "\tdefault: break; \n\t}\n");
+	return fprintf(c, "\treturn -1; \n}\n\n");
+}
+
+static size_t registry_count(dbc_t *dbc, dbc2c_options_t *copts)
+{
+	assert(dbc);
+	assert(copts);
+	size_t count = 0;
+	for (size_t i = 0; i < dbc->message_count; i++)
+		count += msg_generate_unpack(dbc->messages[i], copts);
+	return count;
+}
+
+/* The registry has one bit per received message saying whether it should be
+ * unpacked at all, and a callback called after it has been, messages are
+ * numbered in the order of their ID. A disabled message is not an error,
+ * 'dispatch_message' returns zero for it and leaves the object alone. */
+static int msg2h_registry(dbc_t *dbc, FILE *h, const char *god, dbc2c_options_t *copts)
+{
+	assert(dbc);
+	assert(h);
+	assert(god);
+	assert(copts);
+	const size_t count = registry_count(dbc, copts);
+	const size_t slots = count ? count : 1;
+	fprintf(h, "typedef void (*can_callback_%s_t)(can_obj_%s_t *o, unsigned long id, void *arg);\n\n", god, god);
+	fprintf(h, "typedef struct {\n");
+	fprintf(h, "\tuint32_t enabled[%zu]; /* one bit per message, set to unpack it, if clear 'dispatch_message' does nothing and returns 0 */\n", (slots + 31) / 32);
+	fprintf(h, "\tcan_callback_%s_t callbacks[%zu]; /* called after a message is unpacked, or NULL */\n", god, slots);
+	fprintf(h, "\tvoid *arguments[%zu];\n", slots);
+	return fprintf(h, "} can_registry_%s_t;\n\n", god);
+}
+
+static int registry_functions(FILE *c, dbc_t *dbc, bool prototype, const char *god, dbc2c_options_t *copts)
+{
 	assert(c);
+	assert(dbc);
+	assert(god);
+	assert(copts);
+	const size_t count = registry_count(dbc, copts);
+	const char *end = prototype ? ";\n" : " {\n";
+
+	if (!prototype) {
+		fprintf(c, "static int registry_index(const unsigned long id) {\n");
+		if (copts->use_msg_switches)
+			fprintf(c, "\tDBCC_UNUSED(id);\n");
+		fprintf(c, "\tswitch (id) {\n");
+		for (size_t i = 0, j = 0; i < dbc->message_count; i++)
+			if (msg_generate_unpack(dbc->messages[i], copts)) {
+				msg_switch_open(c, dbc->messages[i], god, copts);
+				fprintf(c, "\tcase 0x%03lx: return %zu;\n", dbc->messages[i]->id, j++);
+				msg_switch_close(c, copts);
+			}
+		fprintf(c, "\tdefault: break; \n\t}\n");
+		fprintf(c, "\treturn -1; \n}\n\n");
+	}
+
+	fprintf(c, "int init_registry(can_registry_%s_t *registry, int enable)%s", god, end);
+	if (!prototype) {
+		if (copts->generate_asserts)
+			fprintf(c, "\tassert(registry);\n");
+		fprintf(c, "\tfor (size_t i = 0; i < sizeof (registry->enabled) / sizeof (registry->enabled[0]); i++)\n");
+		fprintf(c, "\t\tregistry->enabled[i] = enable ? 0xFFFFFFFFul : 0;\n");
+		fprintf(c, "\tfor (size_t i = 0; i < sizeof (registry->callbacks) / sizeof (registry->callbacks[0]); i++) {\n");
+		fprintf(c, "\t\tregistry->callbacks[i] = NULL;\n");
+		fprintf(c, "\t\tregistry->arguments[i] = NULL;\n");
+		fprintf(c, "\t}\n");
+		fprintf(c, "\treturn 0;\n}\n\n");
+	}
+
+	fprintf(c, "int enable_message(can_registry_%s_t *registry, const unsigned long id, int enable)%s", god, end);
+	if (!prototype) {
+		if (copts->generate_asserts)
+			fprintf(c, "\tassert(registry);\n");
+		fprintf(c, "\tconst int i = registry_index(id);\n");
+		fprintf(c, "\tif (i < 0)\n\t\treturn -1;\n");
+		fprintf(c, "\tif (enable)\n\t\tregistry->enabled[i / 32] |= 1ul << (i %% 32);\n");
+		fprintf(c, "\telse\n\t\tregistry->enabled[i / 32] &= ~(1ul << (i %% 32));\n");
+		fprintf(c, "\treturn 0;\n}\n\n");
+	}
+
+	fprintf(c, "int subscribe_message(can_registry_%s_t *registry, const unsigned long id, can_callback_%s_t callback, void *arg)%s", god, god, end);
+	if (!prototype) {
+		if (copts->generate_asserts)
+			fprintf(c, "\tassert(registry);\n");
+		fprintf(c, "\tconst int i = registry_index(id);\n");
+		fprintf(c, "\tif (i < 0)\n\t\treturn -1;\n");
+		fprintf(c, "\tregistry->callbacks[i] = callback;\n");
+		fprintf(c, "\tregistry->arguments[i] = arg;\n");
+		fprintf(c, "\treturn 0;\n}\n\n");
+	}
+
+	/* the bit test comes before any work on the frame, so a disabled
+	 * message costs a switch and a test */
+	fprintf(c, "int dispatch_message(const can_registry_%s_t *registry, can_obj_%s_t *o, const unsigned long id, uint64_t data, uint8_t dlc, dbcc_time_stamp_t time_stamp)%s", god, god, end);
+	if (prototype)
+		return 0;
+	if (copts->generate_asserts) {
+		fprintf(c, "\tassert(registry);\n");
+		fprintf(c, "\tassert(o);\n");
+		fprintf(c, "\tassert(id < (1ul << 29)); /* 29-bit CAN ID is largest possible */\n");
+		fprintf(c, "\tassert(dlc <= 8);         /* Maximum of 8 bytes in a CAN packet */\n");
+	}
+	if (!count || copts->use_msg_switches)
+		fprintf(c, "\tDBCC_UNUSED(registry);\n\tDBCC_UNUSED(o);\n\tDBCC_UNUSED(data);\n\tDBCC_UNUSED(dlc);\n\tDBCC_UNUSED(time_stamp);\n");
+	fprintf(c, "\tint r = 0;\n");
+	fprintf(c, "\tsize_t i = 0;\n");
+	fprintf(c, "\tswitch (id) {\n");
+	for (size_t i = 0, j = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = dbc->messages[i];
+		if (!msg_generate_unpack(msg, copts))
+			continue;
+		char name[MAX_NAME_LENGTH] = {0};
+		make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+		msg_switch_open(c, msg, god, copts);
+		fprintf(c, "\tcase 0x%03lx:\n", msg->id);
+		fprintf(c, "\t\tif (!(registry->enabled[%zu] & 0x%lxul))\n\t\t\treturn 0;\n", j / 32, 1ul << (j % 32));
+		msg_unpack_call(c, name, copts);
+		fprintf(c, "\t\ti = %zu;\n\t\tbreak;\n", j++);
+		msg_switch_close(c, copts);
+	}
+	fprintf(c, "\tdefault: return -1;\n\t}\n");
+	fprintf(c, "\tif (r == 0 && registry->callbacks[i])\n");
+	fprintf(c, "\t\tregistry->callbacks[i](o, id, registry->arguments[i]);\n");
+	return fprintf(c, "\treturn r;\n}\n\n");
+}
+
+static int msg2h_struct(can_msg_t *msg, FILE *h, const char *name, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(h);
 	assert(name);
+	assert(copts);
+	fprintf(h, "typedef PREPACK struct {\n" );
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		size_t index = 0;
+		const signal_array_t *a = signal_array(msg, msg->sigs[i], copts, &index);
+		if (a) {
+			if (index == 0 && signal_array2type(a, h) < 0)
+				return -1;
+			continue;
+		}
+		if (signal_in_union(msg, msg->sigs[i], copts))
+			continue;
+		if (signal2type(msg->sigs[i], h, "\t") < 0)
+			return -1;
+	}
+	if (msg2h_union(msg, h, copts) < 0)
+		return -1;
+	return fprintf(h, "} POSTPACK %s_t;\n\n", name);
+}
+
+static int msg2h_types(dbc_t *dbc, FILE *h, const char *god, dbc2c_options_t *copts)
+{
+	assert(h);
+	assert(dbc);
 	assert(god);
 	assert(copts);
-	fprintf(c, "int print_%s(const can_obj_%s_t *o, FILE *output) {\n", name, god);
-	if (copts->generate_asserts) {
-		fputs("\tassert(o);\n", c);
-		fputs("\tassert(output);\n", c);
-		/* you may note the UNUSED macro may be generated, we should
-		 * still assert we are passed the correct things */
+
+	for (size_t i = 0; i < dbc->val_count; i++) {
+		val_list_t *list = dbc->vals[i];
+		fprintf(h, "typedef enum {\n");
+		for (size_t j = 0; j < list->val_list_item_count; j++) {
+			val_list_item_t *item = list->val_list_items[j];
+			fprintf(h, "\t%s_%s_e = %d,\n", list->name, item->name, item->value);
+		}
+		fprintf(h, "} %s_e;\n\n", list->name);
+	}
+
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = dbc->messages[i];
+		char name[MAX_NAME_LENGTH] = {0};
+		make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+
+		if (msg->comment)
+			fprintf(h, "/* %s */\n", msg->comment);
+
+		if (msg->layout == msg)
+			layout_switch_open(h, dbc, msg, god, copts);
+		else
+			msg_switch_open(h, msg, god, copts);
+		if (msg2h_struct(msg, h, name, copts) < 0)
+			return -1;
+		for (size_t i = 0; i < msg->group_count; i++)
+			if (group_is_generated(msg, msg->groups[i], copts) && group2type(msg, msg->groups[i], h, name, copts) < 0)
+				return -1;
+		msg_switch_close(h, copts);
+	}
+	return 0;
+}
+
+/* ISO C does not allow a structure without members, which the CAN object
+ * would be without messages or with all of them switched off (see '-c') */
+static void msg2h_god_object_placeholder(dbc_t *dbc, FILE *h, const char *object_name, dbc2c_options_t *copts)
+{
+	assert(dbc);
+	assert(h);
+	assert(object_name);
+	assert(copts);
+	const bool switched = copts->use_msg_switches && dbc->message_count;
+	if (dbc->message_count && !switched)
+		return;
+	if (switched) {
+		fputs("#if !(", h);
+		for (size_t i = 0; i < dbc->message_count; i++) {
+			char sw[MAX_NAME_LENGTH * 2] = {0};
+			msg_switch_name(sw, sizeof(sw), dbc->messages[i], object_name, copts);
+			fprintf(h, "%s%s", i ? " || " : "", sw);
+		}
+		fputs(")\n", h);
+	}
+	fputs("\tchar dbcc_no_messages;\n", h);
+	if (switched)
+		fputs("#endif\n", h);
+}
+
+/* Each message gets its time stamp, status bits and signals next to each
+ * other, hottest messages first, with the high rate messages starting on a
+ * fresh cache line, so receiving a frame touches as few lines as possible. */
+static int msg2h_god_object_cache_layout(dbc_t *dbc, FILE *h, const char *object_name, dbc2c_options_t *copts)
+{
+	assert(h);
+	assert(dbc);
+	assert(object_name);
+	assert(copts);
+	int r = 0;
+	can_msg_t **msgs = allocate(sizeof(*msgs) * (dbc->message_count + 1));
+	memcpy(msgs, dbc->messages, sizeof(*msgs) * dbc->message_count);
+	qsort(msgs, dbc->message_count, sizeof(*msgs), message_rate_compare_function);
+
+	fprintf(h, "typedef struct {\n");
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = msgs[i];
+		if (msg->profiled)
+			fprintf(h, "\t/* %s: %.2f%% of profiled frames */\n", msg->name, msg->share * 100.0);
+		else if (msg_cycle_time(msg))
+			fprintf(h, "\t/* %s: cycle time %d ms */\n", msg->name, msg_cycle_time(msg));
+		msg_switch_open(h, msg, object_name, copts);
+		if (msg_data_type_time_stamp(h, msg, msg_is_high_rate(msg), copts) < 0)
+			goto fail;
+		if (msg_data_type_bitfields(h, msg, copts) < 0)
+			goto fail;
+		if (msg_data_type_sequence(h, msg, copts) < 0)
+			goto fail;
+		if (msg_data_type(h, msg, false, copts) < 0)
+			goto fail;
+		msg_switch_close(h, copts);
+	}
+	msg2h_god_object_placeholder(dbc, h, object_name, copts);
+	fprintf(h, "} can_obj_%s_t;\n\n", object_name);
+
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = msgs[i];
+		if (!msg_is_high_rate(msg))
+			continue;
+		char name[MAX_NAME_LENGTH] = {0};
+		make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+		msg_switch_open(h, msg, object_name, copts);
+		fprintf(h, "DBCC_STATIC_ASSERT((offsetof(can_obj_%s_t, %s_time_stamp_rx) %% DBCC_CACHE_LINE) == 0, %s_aligned);\n",
+				object_name, name, name);
+		/* time stamp (at most 8 bytes), bit-fields (at most 8 bytes)
+		 * and sequence counter (at most 8 bytes) precede the signals,
+		 * check they all fit on the line */
+		if ((msg_type_size(msg, copts) + (copts->use_sequence_counter ? 24 : 16)) <= CACHE_LINE_BYTES)
+			fprintf(h, "DBCC_STATIC_ASSERT((offsetof(can_obj_%s_t, %s) + sizeof(%s_t) - offsetof(can_obj_%s_t, %s_time_stamp_rx)) <= DBCC_CACHE_LINE, %s_one_line);\n",
+				object_name, name, name, object_name, name, name);
+		msg_switch_close(h, copts);
+	}
+	fputs("\n", h);
+out:
+	free(msgs);
+	return r;
+fail:
+	r = -1;
+	goto out;
+}
+
+static char *god_object_name(const char *name)
+{
+	assert(name);
+	char *object_name = duplicate(name);
+	const size_t object_name_len = strlen(object_name);
+	for (size_t i = 0; i < object_name_len; i++)
+		object_name[i] = (isalnum(object_name[i])) ?  tolower(object_name[i]) : '_';
+	return object_name;
+}
+
+static int msg2h_god_object(dbc_t *dbc, FILE *h, const char *object_name, dbc2c_options_t *copts)
+{
+	assert(h);
+	assert(dbc);
+	assert(object_name);
+	assert(copts);
+	if (copts->use_cache_layout)
+		return msg2h_god_object_cache_layout(dbc, h, object_name, copts);
+	int r = 0;
+	can_msg_t **msgs = msgs_by_profile(dbc, copts);
+	fprintf(h, "typedef PREPACK struct {\n");
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		msg_switch_open(h, msgs[i], object_name, copts);
+		if (msg_data_type_time_stamp(h, msgs[i], false, copts) < 0)
+			goto fail;
+		msg_switch_close(h, copts);
+	}
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		msg_switch_open(h, msgs[i], object_name, copts);
+		if (msg_data_type_bitfields(h, msgs[i], copts) < 0)
+			goto fail;
+		msg_switch_close(h, copts);
+	}
+	for (size_t i = 0; copts->use_sequence_counter && i < dbc->message_count; i++) {
+		msg_switch_open(h, msgs[i], object_name, copts);
+		if (msg_data_type_sequence(h, msgs[i], copts) < 0)
+			goto fail;
+		msg_switch_close(h, copts);
+	}
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		msg_switch_open(h, msgs[i], object_name, copts);
+		if (msg_data_type(h, msgs[i], false, copts) < 0)
+			goto fail;
+		msg_switch_close(h, copts);
+	}
+	msg2h_god_object_placeholder(dbc, h, object_name, copts);
+	fprintf(h, "} POSTPACK can_obj_%s_t;\n\n", object_name);
+out:
+	free(msgs);
+	return r;
+fail:
+	r = -1;
+	goto out;
+}
+
+/* only emit the float helpers if a generated function needs them, otherwise
+ * we get warnings about unused static functions */
+static bool dbc_uses_float(dbc_t *dbc, dbc2c_options_t *copts, bool pack)
+{
+	assert(dbc);
+	assert(copts);
+	if (!dbc->use_float)
+		return false;
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = dbc->messages[i];
+		if (!(pack ? msg_generate_pack(msg, copts) : msg_generate_unpack(msg, copts)))
+			continue;
+		for (size_t j = 0; j < msg->signal_count; j++)
+			if (msg->sigs[j]->is_floating)
+				return true;
+	}
+	return false;
+}
+
+/* Make a shallow copy of the DBC containing only the messages a node sends
+ * or receives, and of the received messages only the signals that node
+ * listens to (and the multiplexor needed to decode them). The copy shares
+ * the signals, names and value lists with the original DBC. */
+static dbc_t *dbc_prune(dbc_t *dbc, dbc2c_options_t *copts)
+{
+	assert(dbc);
+	assert(copts);
+	assert(copts->node);
+	dbc_t *pruned = allocate(sizeof(*pruned));
+	*pruned = *dbc;
+	pruned->messages = allocate(sizeof(*pruned->messages) * (dbc->message_count + 1));
+	pruned->message_count = 0;
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = dbc->messages[i];
+		const bool tx = msg_is_tx(msg, copts);
+		if (!tx && !msg_is_rx(msg, copts)) {
+			debug("node %s: pruning message %s", copts->node, msg->name);
+			continue;
+		}
+		can_msg_t *copy = allocate(sizeof(*copy));
+		*copy = *msg;
+		copy->sigs = allocate(sizeof(*copy->sigs) * (msg->signal_count + 1));
+		copy->signal_count = 0;
+		bool multiplexed = false;
+		for (size_t j = 0; j < msg->signal_count; j++) {
+			signal_t *sig = msg->sigs[j];
+			if (!tx && !sig->is_multiplexor && !signal_is_received_by(sig, copts->node))
+				continue;
+			multiplexed |= sig->is_multiplexed;
+			copy->sigs[copy->signal_count++] = sig;
+		}
+		if (!multiplexed) { /* drop the multiplexor if we only kept it for nothing */
+			size_t k = 0;
+			for (size_t j = 0; j < copy->signal_count; j++)
+				if (tx || !copy->sigs[j]->is_multiplexor || signal_is_received_by(copy->sigs[j], copts->node))
+					copy->sigs[k++] = copy->sigs[j];
+			copy->signal_count = k;
+		}
+		pruned->messages[pruned->message_count++] = copy;
 	}
-	if (msg->signal_count)
-		fprintf(c, "\tint r = 0;\n"); //fprintf(c, "\tdouble scaled;\n\tint r = 0;\n");
-	else
-		fprintf(c, "\tUNUSED(o);\n\tUNUSED(output);\n");
-	for (size_t i = 0; i < msg->signal_count; i++) {
-		if (signal2print(msg->sigs[i], msg->id, name, c) < 0)
-			return -1;
+	if (!pruned->message_count)
+		warning("node '%s' does not send or receive any messages", copts->node);
+	note("node %s: %zu of %zu messages kept", copts->node, pruned->message_count, dbc->message_count);
+	return pruned;
+}
+
+static void dbc_prune_delete(dbc_t *pruned)
+{
+	if (!pruned)
+		return;
+	for (size_t i = 0; i < pruned->message_count; i++) {
+		free(pruned->messages[i]->sigs);
+		free(pruned->messages[i]);
 	}
-	if (msg->signal_count)
-		fprintf(c, "\treturn r;\n}\n\n");
-	else
-		fprintf(c, "\treturn 0;\n}\n\n");
+	free(pruned->messages);
+	free(pruned);
+}
+
+/* Hardware acceptance filters, a filter admits an identifier 'x' when
+ * '(x & mask) == id'. Standard (11-bit) and extended (29-bit) identifiers
+ * need separate filters. Starting with one filter per received identifier
+ * the two filters whose merge lets through the fewest other messages of the
+ * DBC, and then the fewest identifiers, are merged until one is left. This
+ * is a greedy heuristic, finding the best set of filters is a hard problem,
+ * but the sets of every size up to FILTER_BANKS_MAX come out of one run.
+ * The search compares every pair of filters, above FILTER_INPUT_MAX
+ * identifiers neighbours in sorted order are merged first, cheapest first,
+ * which keeps its time and memory bounded for large DBC files. */
+#define FILTER_BANKS_MAX (32u)
+#define FILTER_INPUT_MAX (128u)
+
+typedef struct {
+	uint32_t id, mask;
+} filter_t;
+
+typedef struct {
+	filter_t filters[FILTER_BANKS_MAX];
+	size_t count;      /* filters used, zero if there are no identifiers */
+	size_t known;      /* other messages of the DBC admitted */
+	uint64_t admitted; /* identifiers admitted, including the wanted ones */
+} filter_set_t;
+
+typedef struct {
+	uint32_t *wanted;    /* identifiers that are received */
+	size_t wanted_count;
+	uint32_t *others;    /* identifiers in the DBC that are not received */
+	size_t other_count;
+	unsigned width;      /* bits in an identifier */
+	filter_set_t sets[FILTER_BANKS_MAX + 1]; /* best set of at most N filters */
+} filter_kind_t;
+
+static bool id_is_extended(unsigned long id)
+{
+	return (id & 0x80000000uL) || (id & 0x1FFFFFFFuL) > 0x7FFuL;
+}
+
+static unsigned bits_set(uint64_t x)
+{
+	unsigned n = 0;
+	for (; x; x &= x - 1)
+		n++;
+	return n;
+}
+
+static filter_t filter_merge(filter_t a, filter_t b)
+{
+	filter_t f;
+	f.mask = a.mask & b.mask & ~(a.id ^ b.id);
+	f.id = a.id & f.mask;
+	return f;
+}
+
+static bool filter_admits(filter_t f, uint32_t x)
+{
+	return (x & f.mask) == f.id;
+}
+
+static bool filter_contains(filter_t a, filter_t b)
+{
+	return !(a.mask & ~b.mask) && (b.id & a.mask) == a.id;
+}
+
+static uint64_t filter_size(filter_t f, unsigned width)
+{
+	return 1uLL << (width - bits_set(f.mask));
+}
+
+static size_t filter_known(filter_t f, const filter_kind_t *k)
+{
+	assert(k);
+	size_t n = 0;
+	for (size_t i = 0; i < k->other_count; i++)
+		n += filter_admits(f, k->others[i]);
+	return n;
+}
+
+/* The identifiers admitted are counted exactly for standard identifiers, for
+ * extended ones overlapping filters are counted twice */
+static void filter_set_measure(const filter_kind_t *k, const filter_t *f, const bool *alive, size_t n, filter_set_t *s)
+{
+	assert(k);
+	assert(f);
+	assert(alive);
+	assert(s);
+	memset(s, 0, sizeof(*s));
+	for (size_t i = 0; i < n; i++)
+		if (alive[i])
+			s->filters[s->count++] = f[i];
+	for (size_t i = 0; i < k->other_count; i++)
+		for (size_t j = 0; j < s->count; j++)
+			if (filter_admits(s->filters[j], k->others[i])) {
+				s->known++;
+				break;
+			}
+	if (k->width > 16) {
+		for (size_t j = 0; j < s->count; j++)
+			s->admitted += filter_size(s->filters[j], k->width);
+		if (s->admitted > (1uLL << k->width))
+			s->admitted = 1uLL << k->width;
+		return;
+	}
+	for (uint32_t x = 0; x < (1uL << k->width); x++)
+		for (size_t j = 0; j < s->count; j++)
+			if (filter_admits(s->filters[j], x)) {
+				s->admitted++;
+				break;
+			}
+}
+
+static int filter_compare(const void *a, const void *b)
+{
+	const filter_t *x = a, *y = b;
+	if (x->id != y->id)
+		return x->id < y->id ? -1 : 1;
+	if (x->mask != y->mask)
+		return x->mask < y->mask ? -1 : 1;
 	return 0;
 }
 
-static int msg_dlc_check(can_msg_t *msg) {
-	assert(msg);
-	const unsigned bits = msg->dlc * 8;
-	unsigned used = 0;
-	if (find_multiplexor(msg)) // skip multiplexed messages for now
-		return 0;
-	for (size_t i = 0; i < msg->signal_count; i++) {
-		signal_t *s = msg->sigs[i];
-		used += s->bit_length;
+typedef struct {
+	uint64_t size; /* identifiers admitted by the merge of f[at] and f[at + 1] */
+	size_t at;
+} filter_pair_t;
+
+static int filter_pair_compare(const void *a, const void *b)
+{
+	const filter_pair_t *x = a, *y = b;
+	if (x->size != y->size)
+		return x->size < y->size ? -1 : 1;
+	if (x->at != y->at)
+		return x->at < y->at ? -1 : 1;
+	return 0;
+}
+
+/* Merge neighbouring filters, in order of the identifiers they admit, until
+ * at most FILTER_INPUT_MAX are left, returning how many. Each round merges
+ * disjoint pairs cheapest first, so takes O(n log n), and at least a third
+ * of the excess goes in each round. */
+static size_t filter_premerge(filter_t *f, size_t n, unsigned width)
+{
+	assert(f);
+	while (n > FILTER_INPUT_MAX) {
+		qsort(f, n, sizeof(*f), filter_compare);
+		filter_pair_t *p = allocate(sizeof(*p) * n);
+		bool *merged = allocate(sizeof(*merged) * n), *gone = allocate(sizeof(*gone) * n);
+		for (size_t i = 0; i + 1 < n; i++) {
+			p[i].size = filter_size(filter_merge(f[i], f[i + 1]), width);
+			p[i].at = i;
+		}
+		qsort(p, n - 1, sizeof(*p), filter_pair_compare);
+		size_t excess = n - FILTER_INPUT_MAX;
+		for (size_t i = 0; i + 1 < n && excess; i++) {
+			const size_t at = p[i].at;
+			if (merged[at] || merged[at + 1])
+				continue;
+			f[at] = filter_merge(f[at], f[at + 1]);
+			merged[at] = merged[at + 1] = true;
+			gone[at + 1] = true;
+			excess--;
+		}
+		size_t kept = 0;
+		for (size_t i = 0; i < n; i++)
+			if (!gone[i])
+				f[kept++] = f[i];
+		n = kept;
+		free(p);
+		free(merged);
+		free(gone);
 	}
-	if (used > bits) {
-		warning("Too many signals, not enough bytes (DLC is too low, fix your DBC file): %s", msg->name);
+	return n;
+}
+
+static void filter_synthesize(filter_kind_t *k)
+{
+	assert(k);
+	size_t n = k->wanted_count;
+	if (!n)
+		return;
+	filter_t *f = allocate(sizeof(*f) * n);
+	const uint32_t all = (uint32_t)((1uLL << k->width) - 1uLL);
+	for (size_t i = 0; i < n; i++) {
+		f[i].id = k->wanted[i];
+		f[i].mask = all;
+	}
+	if (n > FILTER_INPUT_MAX) {
+		n = filter_premerge(f, n, k->width);
+		debug("%zu identifiers merged down to %zu filters before the search", k->wanted_count, n);
+	}
+	bool *alive = allocate(sizeof(*alive) * n);
+	size_t *known = allocate(sizeof(*known) * n);
+	size_t *pair_known = allocate(sizeof(*pair_known) * n * n);
+	uint64_t *pair_size = allocate(sizeof(*pair_size) * n * n);
+	for (size_t i = 0; i < n; i++) {
+		alive[i] = true;
+		known[i] = filter_known(f[i], k);
+	}
+	for (size_t i = 0; i < n; i++)
+		for (size_t j = i + 1; j < n; j++) {
+			const filter_t m = filter_merge(f[i], f[j]);
+			pair_known[i * n + j] = filter_known(m, k);
+			pair_size[i * n + j] = filter_size(m, k->width);
+		}
+
+	size_t live = n, recorded = FILTER_BANKS_MAX + 1;
+	for (;;) {
+		for (size_t c = live; c < recorded; c++)
+			filter_set_measure(k, f, alive, n, &k->sets[c]);
+		recorded = live < recorded ? live : recorded;
+		if (live == 1)
+			break;
+		size_t bi = 0, bj = 0;
+		int64_t best_known = INT64_MAX, best_size = INT64_MAX;
+		for (size_t i = 0; i < n; i++) {
+			if (!alive[i])
+				continue;
+			const int64_t size_i = filter_size(f[i], k->width);
+			for (size_t j = i + 1; j < n; j++) {
+				if (!alive[j])
+					continue;
+				const int64_t dk = (int64_t)pair_known[i * n + j] - (int64_t)known[i] - (int64_t)known[j];
+				const int64_t ds = (int64_t)pair_size[i * n + j] - size_i - (int64_t)filter_size(f[j], k->width);
+				if (dk < best_known || (dk == best_known && ds < best_size)) {
+					best_known = dk;
+					best_size = ds;
+					bi = i;
+					bj = j;
+				}
+			}
+		}
+		f[bi] = filter_merge(f[bi], f[bj]);
+		alive[bj] = false;
+		live--;
+		for (size_t l = 0; l < n; l++)
+			if (alive[l] && l != bi && filter_contains(f[bi], f[l])) {
+				alive[l] = false;
+				live--;
+			}
+		known[bi] = filter_known(f[bi], k);
+		for (size_t l = 0; l < n; l++) {
+			if (!alive[l] || l == bi)
+				continue;
+			const filter_t m = filter_merge(f[bi], f[l]);
+			const size_t at = bi < l ? bi * n + l : l * n + bi;
+			pair_known[at] = filter_known(m, k);
+			pair_size[at] = filter_size(m, k->width);
+		}
+	}
+	free(f);
+	free(alive);
+	free(known);
+	free(pair_known);
+	free(pair_size);
+}
+
+/* Split 'banks' filters between standard and extended identifiers, returns
+ * false if there are too few to cover both */
+static bool filter_split(const filter_kind_t *kinds, size_t banks, size_t *standard)
+{
+	assert(kinds);
+	assert(standard);
+	bool found = false;
+	size_t best_known = 0;
+	uint64_t best_admitted = 0;
+	for (size_t s = 0; s <= banks; s++) {
+		const filter_set_t *a = &kinds[0].sets[s], *b = &kinds[1].sets[banks - s];
+		if ((kinds[0].wanted_count && !a->count) || (kinds[1].wanted_count && !b->count))
+			continue;
+		const size_t known = a->known + b->known;
+		const uint64_t admitted = a->admitted + b->admitted;
+		if (!found || known < best_known || (known == best_known && admitted < best_admitted)) {
+			found = true;
+			best_known = known;
+			best_admitted = admitted;
+			*standard = s;
+		}
+	}
+	return found;
+}
+
+typedef struct {
+	filter_kind_t kinds[2]; /* standard and extended identifiers */
+	size_t banks;           /* filters to use in total */
+	size_t standard;        /* of which for standard identifiers */
+} filters_t;
+
+static int filter_report(FILE *c, const filters_t *f)
+{
+	assert(c);
+	assert(f);
+	const filter_kind_t *kinds = f->kinds;
+	const size_t wanted = kinds[0].wanted_count + kinds[1].wanted_count;
+	const size_t others = kinds[0].other_count + kinds[1].other_count;
+	fprintf(c, "/* Acceptance filters for %zu received messages, %zu other messages in the DBC.\n", wanted, others);
+	fprintf(c, " * 'unwanted' is the number of identifiers admitted that are not received%s,\n", kinds[1].wanted_count ? " (at most)" : "");
+	fprintf(c, " * and the false positive rate, the percentage of those admitted that are\n");
+	fprintf(c, " * unwanted. 'known' is the number of other messages in the DBC admitted.\n");
+	fprintf(c, " *\n * banks        unwanted           known\n");
+	for (size_t k = 1; k <= FILTER_BANKS_MAX; k++) {
+		size_t s = 0;
+		if (!filter_split(kinds, k, &s)) {
+			fprintf(c, " * %5zu  %14s  %14s\n", k, "-", "-");
+			continue;
+		}
+		const filter_set_t *a = &kinds[0].sets[s], *b = &kinds[1].sets[k - s];
+		const uint64_t unwanted = a->admitted + b->admitted - wanted;
+		fprintf(c, " * %5zu  %9"PRIu64" %3.0f%%  %6zu of %zu%s\n", k, unwanted,
+				100.0 * (double)unwanted / (double)(unwanted + wanted), a->known + b->known, others, k == f->banks ? " <- used" : "");
+	}
+	return fputs(" */\n", c);
+}
+
+static void filters_delete(filters_t *f)
+{
+	if (!f)
+		return;
+	for (size_t i = 0; i < 2; i++) {
+		free(f->kinds[i].wanted);
+		free(f->kinds[i].others);
+	}
+	free(f);
+}
+
+/* Filters for the messages that are unpacked, 'full' is the DBC before any
+ * messages were pruned by '-n', which are the other messages on the bus */
+static filters_t *filters_new(dbc_t *dbc, dbc_t *full, dbc2c_options_t *copts)
+{
+	assert(dbc);
+	assert(full);
+	assert(copts);
+	filters_t *f = allocate(sizeof(*f));
+	filter_kind_t *kinds = f->kinds;
+	kinds[0].width = 11;
+	kinds[1].width = 29;
+	for (size_t i = 0; i < 2; i++) {
+		kinds[i].wanted = allocate(sizeof(uint32_t) * (full->message_count + 1));
+		kinds[i].others = allocate(sizeof(uint32_t) * (full->message_count + 1));
+	}
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = dbc->messages[i];
+		if (!msg_generate_unpack(msg, copts))
+			continue;
+		filter_kind_t *k = &kinds[id_is_extended(msg->id)];
+		k->wanted[k->wanted_count++] = msg->id & 0x1FFFFFFFuL;
+	}
+	for (size_t i = 0; i < full->message_count; i++) {
+		const unsigned long id = full->messages[i]->id;
+		filter_kind_t *k = &kinds[id_is_extended(id)];
+		bool wanted = false;
+		for (size_t j = 0; j < k->wanted_count; j++)
+			wanted |= k->wanted[j] == (id & 0x1FFFFFFFuL);
+		if (!wanted)
+			k->others[k->other_count++] = id & 0x1FFFFFFFuL;
+	}
+	if (!kinds[0].wanted_count && !kinds[1].wanted_count) {
+		warning("no messages are received, no acceptance filters generated");
+		filters_delete(f);
+		return NULL;
+	}
+	filter_synthesize(&kinds[0]);
+	filter_synthesize(&kinds[1]);
+
+	f->banks = copts->filter_banks;
+	if (!filter_split(kinds, f->banks, &f->standard)) {
+		warning("%zu filter banks cannot cover standard and extended identifiers, using 2", f->banks);
+		f->banks = 2;
+		filter_split(kinds, f->banks, &f->standard);
+	}
+	debug("acceptance filters: %zu standard, %zu extended", kinds[0].sets[f->standard].count, kinds[1].sets[f->banks - f->standard].count);
+	return f;
+}
+
+static size_t filters_count(const filters_t *f)
+{
+	assert(f);
+	return f->kinds[0].sets[f->standard].count + f->kinds[1].sets[f->banks - f->standard].count;
+}
+
+static int filters2h(const filters_t *f, FILE *h, const char *god)
+{
+	assert(f);
+	assert(h);
+	assert(god);
+	fprintf(h, "#ifndef DBCC_FILTER\n");
+	fprintf(h, "#define DBCC_FILTER\n");
+	fprintf(h, "typedef struct {\n");
+	fprintf(h, "\tuint32_t id;      /* identifier bits that must match */\n");
+	fprintf(h, "\tuint32_t mask;    /* set for each identifier bit that is compared */\n");
+	fprintf(h, "\tuint8_t extended; /* 1 for a 29-bit identifier, 0 for an 11-bit one */\n");
+	fprintf(h, "} dbcc_filter_t;\n");
+	fprintf(h, "#endif\n\n");
+	return fprintf(h, "extern const dbcc_filter_t can_filters_%s[%zu];\n\n", god, filters_count(f));
+}
+
+static int filters2c(const filters_t *f, FILE *c, const char *god)
+{
+	assert(f);
+	assert(c);
+	assert(god);
+	if (filter_report(c, f) < 0)
 		return -1;
+	fprintf(c, "const dbcc_filter_t can_filters_%s[%zu] = {\n", god, filters_count(f));
+	for (size_t i = 0; i < 2; i++) {
+		const filter_kind_t *k = &f->kinds[i];
+		const filter_set_t *set = &k->sets[i ? f->banks - f->standard : f->standard];
+		for (size_t j = 0; j < set->count; j++) {
+			const filter_t *filter = &set->filters[j];
+			size_t matches = 0;
+			for (size_t l = 0; l < k->wanted_count; l++)
+				matches += filter_admits(*filter, k->wanted[l]);
+			fprintf(c, "\t{ .id = 0x%0*"PRIx32", .mask = 0x%0*"PRIx32", .extended = %zu }, /* admits %zu received of %"PRIu64" */\n",
+					i ? 8 : 3, filter->id, i ? 8 : 3, filter->mask, i, matches, filter_size(*filter, k->width));
+		}
 	}
-	return 0;
+	return fprintf(c, "};\n\n");
+}
+
+/* A bus profile is either a log recorded with 'candump', with or without
+ * its '-l' option, or a file of 'id count' lines, one per identifier. Each
+ * line that can be parsed gives an identifier and how often it was seen. */
+static bool profile_number(const char *s, int base, unsigned long *n)
+{
+	assert(s);
+	assert(n);
+	char *end = NULL;
+	*n = strtoul(s, &end, base);
+	return end != s && *end == '\0';
+}
+
+static bool profile_line(char *line, unsigned long *id, unsigned long *count)
+{
+	assert(line);
+	assert(id);
+	assert(count);
+	char *tokens[4] = { NULL };
+	size_t n = 0;
+	for (char *t = strtok(line, " \t\r\n"); t && n < 4; t = strtok(NULL, " \t\r\n"))
+		tokens[n++] = t;
+	*count = 1;
+	for (size_t i = 0; i < n; i++) { /* "(1436509052.249713) vcan0 044#2A366C2A" */
+		char *hash = strchr(tokens[i], '#');
+		if (hash && hash != tokens[i] && tokens[i][0] != '(') {
+			*hash = '\0';
+			return profile_number(tokens[i], 16, id);
+		}
+	}
+	for (size_t i = 1; i < n; i++) /* "vcan0  044   [4]  2A 36 6C 2A" */
+		if (tokens[i][0] == '[')
+			return profile_number(tokens[i - 1], 16, id);
+	if (n == 2) /* "0x044 1200" */
+		return profile_number(tokens[0], 0, id) && profile_number(tokens[1], 10, count);
+	return false;
+}
+
+static void profile_apply(dbc_t *dbc, const char *file)
+{
+	assert(dbc);
+	assert(file);
+	FILE *f = fopen_or_die(file, "rb");
+	unsigned long *counts = allocate(sizeof(*counts) * (dbc->message_count + 1));
+	unsigned long long total = 0, matched = 0, ignored = 0;
+	char line[1024];
+	while (fgets(line, sizeof(line), f)) {
+		unsigned long id = 0, count = 0;
+		if (line[0] == '#' || !profile_line(line, &id, &count)) {
+			ignored++;
+			continue;
+		}
+		total += count;
+		for (size_t i = 0; i < dbc->message_count; i++)
+			if ((dbc->messages[i]->id & 0x1FFFFFFFuL) == (id & 0x1FFFFFFFuL)) {
+				counts[i] += count;
+				matched += count;
+				break;
+			}
+	}
+	if (ferror(f))
+		error("reading profile %s failed: %s", file, emsg());
+	fclose(f);
+	if (!total)
+		error("profile %s contains no frames", file);
+	note("profile %s: %llu frames, %llu for messages in the DBC, %llu lines ignored",
+			file, total, matched, ignored);
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = dbc->messages[i];
+		msg->profiled = true;
+		msg->share = (double)counts[i] / (double)total;
+		debug("%s: %.3f%% of profiled frames", msg->name, msg->share * 100.0);
+	}
+	free(counts);
 }
 
-static int msg2c(can_msg_t *msg, FILE *c, dbc2c_options_t *copts, char *god)
+/* With '-m' the dispatch functions call into other translation units */
+static int msg2prototypes(can_msg_t *msg, FILE *c, const char *god, dbc2c_options_t *copts)
 {
 	assert(msg);
 	assert(c);
-	assert(copts);
 	assert(god);
+	assert(copts);
 	char name[MAX_NAME_LENGTH] = {0};
 	make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
-	bool motorola_used = false;
-	bool intel_used = false;
+	msg_switch_open(c, msg, god, copts);
+	if (msg_generate_pack(msg, copts))
+		print_function_name(c, "pack", name, ";\n", false, "uint64_t", false, god, true);
+	if (msg_generate_unpack(msg, copts))
+		print_function_name(c, "unpack", name, ";\n", true, "uint64_t", true, god, true);
+	if (copts->generate_print)
+		fprintf(c, "int print_%s(const can_obj_%s_t *o, FILE *output);\n", name, god);
+	if (copts->generate_format)
+		fprintf(c, "int format_%s(const can_obj_%s_t *o, char *buf, size_t len);\n", name, god);
+	if (copts->generate_serialize) {
+		static const char *kinds[] = { "json", "csv", "bin", };
+		for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++)
+			fprintf(c, "int serialize_%s_%s(const can_obj_%s_t *o, char *buf, size_t len);\n", kinds[i], name, god);
+	}
+	msg_switch_close(c, copts);
+	return 0;
+}
 
-	for (size_t i = 0; i < msg->signal_count; i++)
-		if (msg->sigs[i]->endianess == endianess_motorola_e)
-			motorola_used = true;
-		else
-			intel_used = true;
+/* The shared functions the wrappers of the messages in a part call, they
+ * are generated in the main C file */
+static int part_layout_prototypes(can_msg_t **msgs, size_t count, FILE *c, const char *god, dbc2c_options_t *copts)
+{
+	assert(msgs);
+	assert(c);
+	assert(god);
+	assert(copts);
+	for (size_t i = 0; i < count; i++) {
+		can_msg_t *msg = msgs[i];
+		bool seen = false;
+		for (size_t j = 0; j < i && !copts->use_msg_switches; j++)
+			seen = seen || msgs[j]->layout == msg->layout;
+		if (!msg->layout || seen)
+			continue;
+		char layout[MAX_NAME_LENGTH] = {0};
+		make_name(layout, MAX_NAME_LENGTH, msg->layout->name, msg->layout->id, copts);
+		msg_switch_open(c, msg, god, copts);
+		if (msg_generate_pack(msg, copts))
+			fprintf(c, "int pack_layout_%s(const void *in, uint64_t *data);\n", layout);
+		if (msg_generate_unpack(msg, copts))
+			fprintf(c, "int unpack_layout_%s(void *out, uint64_t data, uint8_t dlc);\n", layout);
+		if (layout2raw(NULL, msg->layout, c, god, NULL, copts) < 0)
+			return -1;
+		msg_switch_close(c, copts);
+		fputc('\n', c);
+	}
+	return 0;
+}
 
-	/* sanity checks against messages should go here, we could check for;
-	 * - odd min/max values given scaling
-	 * - duplicate signals and messages
-	 * They really should go into a semantic analysis phase after reading
-	 * in the DBC file and parsing it. Oh Well. */
-	msg_dlc_check(msg);
+/* The switches default to on, a build can turn messages off with '-D' or
+ * with a copy of the generated configuration template */
+static int msg_switches2h(dbc_t *dbc, FILE *h, const char *god, dbc2c_options_t *copts)
+{
+	assert(dbc);
+	assert(h);
+	assert(god);
+	assert(copts);
+	char prefix[MAX_NAME_LENGTH] = {0};
+	switch_prefix(prefix, sizeof(prefix), god);
+	char *config = god_object_name(prefix);
+	fprintf(h, "#ifdef %s_CONFIG\n", prefix);
+	fprintf(h, "#include \"%s_config.h\"\n", config);
+	fprintf(h, "#endif\n\n");
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		char sw[MAX_NAME_LENGTH * 2] = {0};
+		msg_switch_name(sw, sizeof(sw), dbc->messages[i], god, copts);
+		fprintf(h, "#ifndef %s\n#define %s (1)\n#endif\n", sw, sw);
+	}
+	free(config);
+	return fputs("\n", h);
+}
 
-	if (copts->generate_pack && msg_pack(msg, c, name, motorola_used, intel_used, god, copts) < 0)
-		return -1;
+/* A template for the message switches, 'dbcc_<file>_config.h' next to the
+ * generated C, to be copied and edited for each variant of a build */
+static int msg_switches_template(dbc_t *dbc, const char *name, const char *base, const char *god, dbc2c_options_t *copts)
+{
+	assert(dbc);
+	assert(name);
+	assert(base);
+	assert(god);
+	assert(copts);
+	char prefix[MAX_NAME_LENGTH] = {0};
+	switch_prefix(prefix, sizeof(prefix), god);
+	char *config = god_object_name(prefix);
+	const char *slash = strrchr(base, '/');
+	const int dir = slash ? (int)(slash - base) + 1 : 0;
+	const size_t path_len = strlen(base) + strlen(config) + 16;
+	char *path = allocate(path_len);
+	snprintf(path, path_len, "%.*s%s_config.h", dir, base, config);
 
-	if (copts->generate_unpack && msg_unpack(msg, c, name, motorola_used, intel_used, god, copts) < 0)
-		return -1;
+	FILE *t = tmpfile();
+	if (!t)
+		error("could not create temporary file: %s", emsg());
+	fprintf(t, "/** Message switches for '%s': automatically generated template\n", name);
+	fprintf(t, "  * Set a switch to 0 to compile a message out of the codec, define\n");
+	fprintf(t, "  * %s_CONFIG to have '%s' include this file. */\n", prefix, name);
+	fprintf(t, "#ifndef %s_CONFIG_H\n#define %s_CONFIG_H\n\n", prefix, prefix);
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		char sw[MAX_NAME_LENGTH * 2] = {0};
+		msg_switch_name(sw, sizeof(sw), dbc->messages[i], god, copts);
+		fprintf(t, "#define %s (1)\n", sw);
+	}
+	fprintf(t, "\n#endif\n");
+	const int r = file_update(path, t);
+	fclose(t);
+	free(path);
+	free(config);
+	return r;
+}
 
-	for (size_t i = 0; i < msg->signal_count; i++) {
-		if (copts->generate_unpack)
-			if (signal2scaling(name, msg->id, msg->sigs[i], c, true, false, god, copts) < 0)
-				return -1;
-		if (copts->generate_pack)
-			if (signal2scaling(name, msg->id, msg->sigs[i], c, false, false, god, copts) < 0)
-				return -1;
+/* A static estimate of the work done by the generated functions of each
+ * message, to find the expensive messages before timing them on a target.
+ * Operations are counted on the longest path through the code that is
+ * generated, the shift and mask code or its 32-bit word variant ('-w'), for
+ * the register width of the cost model. The memcpy overlays of '-O' and the
+ * BMI2 functions of '-B' are selected at build or run time and are counted
+ * as the shift and mask code they replace, and every multiplexed signal is counted as if its multiplexor
+ * value was active. The counts are weighted by the cycles and bytes per
+ * operation of the cost model, for the CSV file '<base>_cost.csv' */
+typedef enum {
+	OP_SHIFT_E,  /* shifts, and the byte swap of a frame */
+	OP_MASK_E,   /* and, or */
+	OP_FLOAT_E,  /* floating point arithmetic, comparisons and conversions */
+	OP_BRANCH_E, /* conditional branches, including range checks */
+	OP_TABLE_E,  /* loads from a lookup table */
+	OP_CALL_E,   /* function calls, a function counts one for itself */
+	OP_MAX_E,
+} op_e;
+
+static const char *op_names[OP_MAX_E] = { "shift", "mask", "float", "branch", "table", "call", };
+
+typedef struct {
+	unsigned long ops[OP_MAX_E];
+} op_count_t;
+
+typedef struct {
+	double cycles[OP_MAX_E];
+	double bytes[OP_MAX_E];
+	unsigned word; /* register width in bits, 32 or 64 */
+} cost_model_t;
+
+/* a 32-bit micro-controller without a double precision FPU */
+static const cost_model_t cost_model_default = {
+	.cycles = { 1.0, 1.0, 40.0, 3.0, 2.0, 6.0, },
+	.bytes  = { 4.0, 4.0,  8.0, 4.0, 6.0, 8.0, },
+	.word   = 32,
+};
+
+/* Lines of 'operation cycles [bytes]', or 'word bits' for the register
+ * width, '#' starts a comment line */
+static void cost_model_load(cost_model_t *m, const char *file)
+{
+	assert(m);
+	assert(file);
+	FILE *f = fopen_or_die(file, "rb");
+	char line[256];
+	for (unsigned long number = 1; fgets(line, sizeof(line), f); number++) {
+		char op[32] = {0};
+		double cycles = 0.0, bytes = 0.0;
+		if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+			continue;
+		const int n = sscanf(line, "%31s %lf %lf", op, &cycles, &bytes);
+		if (n < 2 || cycles < 0.0 || bytes < 0.0)
+			error("%s:%lu: expected 'operation cycles [bytes]'", file, number);
+		if (!strcmp(op, "word")) {
+			if (cycles != 32.0 && cycles != 64.0)
+				error("%s:%lu: expected 'word 32' or 'word 64'", file, number);
+			m->word = cycles;
+			continue;
+		}
+		size_t i = 0;
+		while (i < OP_MAX_E && strcmp(op, op_names[i]))
+			i++;
+		if (i == OP_MAX_E)
+			error("%s:%lu: unknown operation '%s'", file, number, op);
+		m->cycles[i] = cycles;
+		if (n == 3)
+			m->bytes[i] = bytes;
 	}
+	if (ferror(f))
+		error("reading cost model %s failed: %s", file, emsg());
+	fclose(f);
+}
 
-	if (copts->generate_print && msg_print(msg, c, name, god, copts) < 0)
-		return -1;
+/* The portable IEEE-754 conversions normalize with a loop over the exponent,
+ * they are shared helpers so only the call is part of the code of a message */
+static void ops_ieee754(op_count_t *c, unsigned bits, bool pack, bool code)
+{
+	assert(c);
+	if (code) {
+		c->ops[OP_CALL_E]++;
+		return;
+	}
+	const unsigned long loop = pack ? 1024 : (bits == 32 ? 127 : 1023);
+	c->ops[OP_FLOAT_E] += loop + 4;
+	c->ops[OP_BRANCH_E] += loop + 4;
+	c->ops[OP_CALL_E]++;
+}
 
-	return 0;
+/* Moving a field of 'length' bits at 'start' in the frame to or from bit 0
+ * with 'word' bit registers takes for each register of the field a shift,
+ * unless it is aligned, and a mask, or an or as well when packing. Where it
+ * straddles two registers it takes a shift of each and an or. */
+static void ops_field(op_count_t *c, unsigned start, unsigned length, unsigned word, bool pack)
+{
+	assert(c);
+	assert(word == 32 || word == 64);
+	for (unsigned done = 0; done < length; done += word) {
+		const unsigned at = start + done;
+		const unsigned n = (length - done) < word ? (length - done) : word;
+		const bool straddles = (at / word) != ((at + n - 1) / word);
+		c->ops[OP_SHIFT_E] += (at % word != 0) + straddles;
+		c->ops[OP_MASK_E] += 1 + pack + straddles;
+	}
 }
 
-static int msg2h(can_msg_t *msg, FILE *h, dbc2c_options_t *copts, const char *god)
+/* The byte swap of the frame, a 64-bit swap takes two with 32-bit registers.
+ * The word variant ('-w') works on 32-bit halves of the frame on any target,
+ * with 64-bit registers splitting the frame into them, or joining them,
+ * takes a shift (and an or). */
+static unsigned msg_frame_ops(can_msg_t *msg, op_count_t *c, unsigned word, bool pack, dbc2c_options_t *copts)
 {
 	assert(msg);
-	assert(h);
+	assert(c);
 	assert(copts);
-	assert(god);
-	char name[MAX_NAME_LENGTH] = {0};
-	make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+	const unsigned swap = msg_swap_width(msg);
+	const bool words = msg_uses_words(msg, copts);
+	const unsigned width = words ? 32 : word;
+	if (swap)
+		c->ops[OP_SHIFT_E] += (swap == 64 && width == 32) ? 2 : 1;
+	if (words && word == 64) {
+		c->ops[OP_SHIFT_E]++;
+		c->ops[OP_MASK_E] += pack;
+	}
+	return width;
+}
 
+static void msg_unpack_ops(can_msg_t *msg, op_count_t *c, bool code, unsigned word, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(c);
+	assert(copts);
+	const unsigned swap = msg_swap_width(msg);
+	c->ops[OP_CALL_E]++;
+	c->ops[OP_BRANCH_E]++; /* DLC check */
+	const unsigned width = msg_frame_ops(msg, c, word, false, copts);
 	for (size_t i = 0; i < msg->signal_count; i++) {
-		if (copts->generate_unpack)
-			if (signal2scaling(name, msg->id, msg->sigs[i], h, true, true, god, copts) < 0)
-				return -1;
-		if (copts->generate_pack)
-			if (signal2scaling(name, msg->id, msg->sigs[i], h, false, true, god, copts) < 0)
-				return -1;
+		signal_t *sig = msg->sigs[i];
+		const unsigned length = sig->bit_length;
+		ops_field(c, signal_shift(sig, swap), length, width, false);
+		c->ops[OP_BRANCH_E] += sig->is_multiplexed;
+		if (sig->is_floating)
+			ops_ieee754(c, length, false, code);
+		else if (sig->is_signed && length != 8 && length != 16 && length != 32 && length != 64)
+			c->ops[OP_BRANCH_E]++, c->ops[OP_MASK_E] += 2 * ((length + width - 1) / width); /* sign extension */
 	}
-	fputs("\n\n", h);
-	return 0;
 }
 
-static const char *cfunctions =
-"static inline uint64_t reverse_byte_order(uint64_t x) {\n"
-"\tx = (x & 0x00000000FFFFFFFF) << 32 | (x & 0xFFFFFFFF00000000) >> 32;\n"
-"\tx = (x & 0x0000FFFF0000FFFF) << 16 | (x & 0xFFFF0000FFFF0000) >> 16;\n"
-"\tx = (x & 0x00FF00FF00FF00FF) << 8  | (x & 0xFF00FF00FF00FF00) >> 8;\n"
-"\treturn x;\n"
-"}\n\n";
-static const char *cfunctions_print_only =
-"static inline int print_helper(int r, int print_return_value) {\n"
-"\treturn ((r >= 0) && (print_return_value >= 0)) ? r + print_return_value : -1;\n"
-"}\n\n";
+static void msg_pack_ops(can_msg_t *msg, op_count_t *c, bool code, unsigned word, dbc2c_options_t *copts)
+{
+	assert(msg);
+	assert(c);
+	assert(copts);
+	const unsigned swap = msg_swap_width(msg);
+	c->ops[OP_CALL_E]++;
+	const unsigned width = msg_frame_ops(msg, c, word, true, copts);
+	for (size_t i = 0; i < msg->signal_count; i++) {
+		signal_t *sig = msg->sigs[i];
+		ops_field(c, signal_shift(sig, swap), sig->bit_length, width, true);
+		c->ops[OP_BRANCH_E] += sig->is_multiplexed;
+		if (sig->is_floating)
+			ops_ieee754(c, sig->bit_length, true, code);
+	}
+}
 
-static int message_compare_function(const void *a, const void *b)
+/* Conditional branches on the longest path through a switch of 'cases'
+ * cases compiled to a binary search */
+static unsigned long switch_depth(size_t cases)
 {
-	assert(a);
-	assert(b);
-	can_msg_t *ap = *((can_msg_t**)a);
-	can_msg_t *bp = *((can_msg_t**)b);
-	if (ap->id <  bp->id) return -1;
-	if (ap->id == bp->id) return  0;
-	if (ap->id >  bp->id) return  1;
-	return 0;
+	unsigned long depth = 0;
+	while (cases) {
+		depth++;
+		cases >>= 1;
+	}
+	return depth;
 }
 
-static int signal_compare_function(const void *a, const void *b)
+static void signal_decode_ops(signal_t *sig, int table, op_count_t *c)
 {
-	assert(a);
-	assert(b);
-	signal_t *ap = *((signal_t**)a);
-	signal_t *bp = *((signal_t**)b);
-	if (ap->bit_length <  bp->bit_length) return  1;
-	if (ap->bit_length == bp->bit_length) return  0;
-	if (ap->bit_length >  bp->bit_length) return -1;
-	return 0;
+	assert(sig);
+	assert(c);
+	c->ops[OP_CALL_E]++;
+	if (table) { /* 1 if all raw values are valid, 2 if the bitset is tested */
+		c->ops[OP_TABLE_E] += table;
+		c->ops[OP_BRANCH_E] += table - 1;
+		return;
+	}
+	raw_bounds_t b;
+	if (signal_raw_bounds(sig, &b))
+		c->ops[OP_BRANCH_E] += b.check_lo + b.check_hi;
+	if (sig->scaling != 1.0 || sig->offset != 0.0)
+		c->ops[OP_FLOAT_E] += 1 + (sig->scaling != 1.0) + (sig->offset != 0.0);
+	if (sig->is_floating && signal_are_min_max_valid(sig)) {
+		c->ops[OP_FLOAT_E] += 2;
+		c->ops[OP_BRANCH_E] += 2;
+	}
 }
 
-static int switch_function(FILE *c, dbc_t *dbc, char *function, bool unpack,
-		bool prototype, const char *datatype, bool dlc, const char *god, dbc2c_options_t *copts)
+static void signal_encode_ops(signal_t *sig, dbc2c_options_t *copts, op_count_t *c)
 {
-	assert(c);
-	assert(dbc);
-	assert(function);
-	assert(god);
+	assert(sig);
 	assert(copts);
-	fprintf(c, "int %s_message(can_obj_%s_t *o, const unsigned long id, %s %sdata%s)",
-			function, god, datatype, unpack ? "" : "*",
-			dlc ? ", uint8_t dlc, dbcc_time_stamp_t time_stamp" : "");
-	if (prototype)
-		return fprintf(c, ";\n");
-	fprintf(c, " {\n");
-	if (copts->generate_asserts) {
-		fprintf(c, "\tassert(o);\n");
-		fprintf(c, "\tassert(id < (1ul << 29)); /* 29-bit CAN ID is largest possible */\n");
-		if (dlc)
-			fprintf(c, "\tassert(dlc <= 8);         /* Maximum of 8 bytes in a CAN packet */\n");
+	assert(c);
+	const bool is_double = !strcmp(signal_encode_type(sig, copts), "double");
+	c->ops[OP_CALL_E]++;
+	if (sig->is_floating && signal_are_min_max_valid(sig)) {
+		c->ops[OP_FLOAT_E] += 2;
+		c->ops[OP_BRANCH_E] += 2;
 	}
-
-	fprintf(c, "\tswitch (id) {\n");
-	for (size_t i = 0; i < dbc->message_count; i++) {
-		can_msg_t *msg = dbc->messages[i];
-		char name[MAX_NAME_LENGTH] = {0};
-		make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
-		fprintf(c, "\tcase 0x%03lx: return %s_%s(o, data%s);\n",
-				msg->id,
-				function,
-				name,
-				dlc ? ", dlc, time_stamp" : "");
+	c->ops[OP_FLOAT_E] += (sig->offset != 0.0) + (sig->scaling != 1.0) + is_double;
+	if (is_double && !sig->is_floating) { /* rounding */
+		c->ops[OP_FLOAT_E] += 2;
+		c->ops[OP_BRANCH_E]++;
+	}
+	raw_bounds_t b;
+	if (signal_encode_bounds(sig, is_double, &b)) {
+		c->ops[OP_BRANCH_E] += b.check_lo + b.check_hi;
+		if (is_double)
+			c->ops[OP_FLOAT_E] += b.check_lo + b.check_hi;
 	}
-	fprintf(c, "\tdefault: break; \n\t}\n");
-	return fprintf(c, "\treturn -1; \n}\n\n");
 }
 
-static int switch_function_print(FILE *c, dbc_t *dbc, bool prototype, const char *god, dbc2c_options_t *copts)
+static void ops_add(op_count_t *to, const op_count_t *from)
+{
+	assert(to);
+	assert(from);
+	for (size_t i = 0; i < OP_MAX_E; i++)
+		to->ops[i] += from->ops[i];
+}
+
+static double ops_cost(const op_count_t *c, const double *per_op)
+{
+	assert(c);
+	assert(per_op);
+	double total = 0.0;
+	for (size_t i = 0; i < OP_MAX_E; i++)
+		total += c->ops[i] * per_op[i];
+	return total;
+}
+
+static void report_row(FILE *o, const char *id, const char *name, const char *function, const op_count_t *c, double bytes, unsigned object, const cost_model_t *m)
 {
+	assert(o);
+	assert(id);
+	assert(name);
+	assert(function);
 	assert(c);
+	assert(m);
+	fprintf(o, "%s,%s,%s", id, name, function);
+	for (size_t i = 0; i < OP_MAX_E; i++)
+		fprintf(o, ",%lu", c->ops[i]);
+	fprintf(o, ",%.0f,%.0f,%u\n", ops_cost(c, m->cycles), bytes, object);
+}
+
+static int report2csv(dbc_t *dbc, const char *base, dbc2c_options_t *copts)
+{
 	assert(dbc);
-	assert(god);
+	assert(base);
 	assert(copts);
-	fprintf(c, "int print_message(const can_obj_%s_t *o, const unsigned long id, FILE *output)", god);
-	if (prototype)
-		return fprintf(c, ";\n");
-	fprintf(c, " {\n");
-	if (copts->generate_asserts) {
-		fprintf(c, "\tassert(o);\n");
-		fprintf(c, "\tassert(id < (1ul << 29)); /* 29-bit CAN ID is largest possible */\n");
-		fprintf(c, "\tassert(output);\n");
-	}
+	cost_model_t m = cost_model_default;
+	if (copts->cost_model)
+		cost_model_load(&m, copts->cost_model);
+	const size_t path_len = strlen(base) + 16;
+	char *path = allocate(path_len);
+	snprintf(path, path_len, "%s_cost.csv", base);
+	FILE *o = fopen_or_die(path, "wb");
 
-	fprintf(c, "\tswitch (id) {\n");
+	fputs("id,name,function", o);
+	for (size_t i = 0; i < OP_MAX_E; i++)
+		fprintf(o, ",%s", op_names[i]);
+	fputs(",cycles,code_bytes,object_bytes\n", o);
+
+	op_count_t worst_unpack = { .ops = { 0 } }, worst_pack = { .ops = { 0 } };
+	size_t budget = copts->table_budget;
 	for (size_t i = 0; i < dbc->message_count; i++) {
 		can_msg_t *msg = dbc->messages[i];
-		char name[MAX_NAME_LENGTH] = {0};
+		char name[MAX_NAME_LENGTH] = {0}, id[32] = {0};
 		make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
-		fprintf(c, "\tcase 0x%03lx: return print_%s(o, output);\n", msg->id, name);
+		snprintf(id, sizeof(id), "0x%03lx", msg->id);
+		const unsigned object = msg_type_size(msg, copts) + sizeof(uint32_t) + 1 + (copts->use_sequence_counter ? sizeof(unsigned) : 0);
+		const bool shared = msg->layout && msg->layout != msg; /* only a wrapper of its own */
+
+		op_count_t decode = { .ops = { 0 } }, encode = { .ops = { 0 } };
+		double decode_bytes = 0.0, encode_bytes = 0.0;
+		int table = 0;
+		for (size_t j = 0; j < msg->signal_count; j++) {
+			signal_t *sig = msg->sigs[j];
+			size_t index = 0;
+			const bool in_array = signal_array(msg, sig, copts, &index) != NULL;
+			const bool generated = !in_array || index == 0; /* one function per array */
+			if (generated) {
+				table = 0;
+				bool all_valid = true;
+				if (msg_generate_unpack(msg, copts) && budget && signal_is_table_candidate(sig)) {
+					const size_t cost = signal_table_cost(sig, &all_valid);
+					if (cost <= budget) {
+						budget -= cost;
+						table = all_valid ? 1 : 2;
+					}
+				}
+			}
+			op_count_t d = { .ops = { 0 } }, e = { .ops = { 0 } };
+			signal_decode_ops(sig, table, &d);
+			signal_encode_ops(sig, copts, &e);
+			ops_add(&decode, &d);
+			ops_add(&encode, &e);
+			if (generated) {
+				decode_bytes += ops_cost(&d, m.bytes);
+				encode_bytes += ops_cost(&e, m.bytes);
+			}
+		}
+
+		if (msg_generate_unpack(msg, copts)) {
+			op_count_t c = { .ops = { 0 } }, code = { .ops = { 0 } };
+			msg_unpack_ops(msg, &c, false, m.word, copts);
+			msg_unpack_ops(msg, &code, true, m.word, copts);
+			const double bytes = shared ? 2.0 * m.bytes[OP_CALL_E] : ops_cost(&code, m.bytes);
+			report_row(o, id, name, "unpack", &c, bytes, object, &m);
+			report_row(o, id, name, "decode", &decode, decode_bytes, object, &m);
+			if (ops_cost(&c, m.cycles) > ops_cost(&worst_unpack, m.cycles))
+				worst_unpack = c;
+		}
+		if (msg_generate_pack(msg, copts)) {
+			op_count_t c = { .ops = { 0 } }, code = { .ops = { 0 } };
+			msg_pack_ops(msg, &c, false, m.word, copts);
+			msg_pack_ops(msg, &code, true, m.word, copts);
+			const double bytes = shared ? 2.0 * m.bytes[OP_CALL_E] : ops_cost(&code, m.bytes);
+			report_row(o, id, name, "pack", &c, bytes, object, &m);
+			report_row(o, id, name, "encode", &encode, encode_bytes, object, &m);
+			if (ops_cost(&c, m.cycles) > ops_cost(&worst_pack, m.cycles))
+				worst_pack = c;
+		}
 	}
-	fprintf(c, "\tdefault: break; \n\t}\n");
-	return fprintf(c, "\treturn -1; \n}\n\n");
+
+	/* The dispatch functions add a call and the branches of their switch to
+	 * the worst message, for 'unpack_message' after failing every test of a
+	 * profiled message before the switch (see msgs_pre_tested) */
+	size_t unpack_cases = 0, pack_cases = 0, tested = 0;
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		unpack_cases += msg_generate_unpack(dbc->messages[i], copts);
+		pack_cases += msg_generate_pack(dbc->messages[i], copts);
+	}
+	can_msg_t **msgs = msgs_by_profile(dbc, copts);
+	msgs_pre_tested(dbc, msgs, &tested, copts);
+	free(msgs);
+	worst_unpack.ops[OP_CALL_E]++;
+	worst_unpack.ops[OP_BRANCH_E] += tested + switch_depth(unpack_cases - tested);
+	worst_pack.ops[OP_CALL_E]++;
+	worst_pack.ops[OP_BRANCH_E] += switch_depth(pack_cases);
+	const double dispatch_bytes = dbc->message_count * (m.bytes[OP_BRANCH_E] + m.bytes[OP_CALL_E]);
+	if (copts->generate_unpack)
+		report_row(o, "", "unpack_message", "unpack", &worst_unpack, dispatch_bytes, 0, &m);
+	if (copts->generate_pack)
+		report_row(o, "", "pack_message", "pack", &worst_pack, dispatch_bytes, 0, &m);
+	const int r = ferror(o) ? -1 : 0;
+	fclose(o);
+	note("wrote report %s", path);
+	free(path);
+	return r;
 }
 
-static int msg2h_types(dbc_t *dbc, FILE *h, dbc2c_options_t *copts)
+static void includes2c(dbc_t *dbc, FILE *c, dbc2c_options_t *copts)
 {
-	assert(h);
 	assert(dbc);
+	assert(c);
 	assert(copts);
+	fprintf(c, "#include <inttypes.h>\n");
+	if (dbc->use_float)
+		fprintf(c, "#include <math.h> /* uses macros NAN, INFINITY, signbit, no need for -lm */\n");
+	if (copts->generate_asserts && !copts->header_only)
+		fprintf(c, "#include <assert.h>\n");
+	if (copts->generate_serialize || copts->share_layouts || dbc_uses_overlay(dbc, copts))
+		fprintf(c, "#include <string.h>\n");
+	if (dbc_uses_overlay(dbc, copts))
+		fprintf(c, "#include <stddef.h>\n");
+	fputc('\n', c);
+}
 
-	for (size_t i = 0; i < dbc->val_count; i++) {
-		val_list_t *list = dbc->vals[i];
-		fprintf(h, "typedef enum {\n");
-		for (size_t j = 0; j < list->val_list_item_count; j++) {
-			val_list_item_t *item = list->val_list_items[j];
-			fprintf(h, "\t%s_%s_e = %d,\n", list->name, item->name, item->value);
+typedef enum {
+	HELPERS_STATIC_E,  /* static definitions, for a single C file */
+	HELPERS_DEFINE_E,  /* external definitions, in the main C file with '-m' */
+	HELPERS_DECLARE_E, /* their prototypes, in each part */
+} helpers_e;
+
+/* Emit the helper functions in 'text', each of which starts with a line of
+ * the form "static [inline] <type> <name>(<parameters>) {". Defined or
+ * declared for other files they lose their 'static', and are renamed with a
+ * macro so that the helpers of different DBC files do not clash. */
+static void helper2c(FILE *c, const char *text, helpers_e how, const char *god)
+{
+	assert(c);
+	assert(text);
+	assert(god);
+	if (how == HELPERS_STATIC_E) {
+		fputs(text, c);
+		return;
+	}
+	int depth = 0;
+	for (const char *line = text, *end = NULL; *line; line = end) {
+		end = strchr(line, '\n');
+		end = end ? end + 1 : line + strlen(line);
+		const int len = end - line, outer = depth;
+		for (const char *p = line; p < end; p++)
+			depth += (*p == '{') - (*p == '}');
+		if (outer || strncmp(line, "static ", 7)) {
+			if (!outer || how == HELPERS_DEFINE_E)
+				fwrite(line, 1, len, c);
+			continue;
 		}
-		fprintf(h, "} %s_e;\n\n", list->name);
+		const char *decl = line + 7, *paren = strchr(line, '(');
+		if (!strncmp(decl, "inline ", 7))
+			decl += 7;
+		const char *name = paren;
+		while (name > decl && (isalnum((unsigned char)name[-1]) || name[-1] == '_'))
+			name--;
+		fprintf(c, "#define %.*s dbcc_%s_%.*s\n", (int)(paren - name), name, god, (int)(paren - name), name);
+		if (how == HELPERS_DEFINE_E) {
+			fwrite(decl, 1, end - decl, c);
+			continue;
+		}
+		const char *close = paren;
+		for (int nest = 0; close < end; close++)
+			if ((nest += (*close == '(') - (*close == ')')) == 0)
+				break;
+		fprintf(c, "%.*s;\n", (int)(close - decl + 1), decl);
 	}
+}
 
-	for (size_t i = 0; i < dbc->message_count; i++) {
-		can_msg_t *msg = dbc->messages[i];
-		char name[MAX_NAME_LENGTH] = {0};
-		make_name(name, MAX_NAME_LENGTH, msg->name, msg->id, copts);
+static void helpers2c(dbc_t *dbc, FILE *c, helpers_e how, const char *god, dbc2c_options_t *copts)
+{
+	assert(dbc);
+	assert(c);
+	assert(god);
+	assert(copts);
+	fprintf(c, "#ifndef DBCC_UNUSED\n#define DBCC_UNUSED(X) ((void)(X))\n#endif\n\n");
+	helper2c(c, cfunctions, how, god);
+	if (dbc_uses_overlay(dbc, copts))
+		fputs(cfunctions_overlay_only, c);
+	if (copts->share_layouts || dbc_uses_overlay(dbc, copts))
+		fputs(cfunctions_static_assert, c);
+	if (copts->use_bmi2)
+		fputs(cfunctions_bmi2_only, c);
+	if (copts->generate_print && !copts->generate_format)
+		helper2c(c, cfunctions_print_only, how, god);
+	if (copts->generate_format || copts->generate_serialize)
+		helper2c(c, cfunctions_format_only, how, god);
+	if (copts->generate_serialize)
+		helper2c(c, cfunctions_serialize_only, how, god);
 
-		if (msg->comment)
-			fprintf(h, "/* %s */\n", msg->comment);
+	if (dbc_uses_float(dbc, copts, false))
+		helper2c(c, float_unpack, how, god);
+	if (dbc_uses_float(dbc, copts, true))
+		helper2c(c, float_pack, how, god);
+}
 
-		fprintf(h, "typedef PREPACK struct {\n" );
-		for (size_t i = 0; i < msg->signal_count; i++)
-			if (signal2type(msg->sigs[i], h) < 0)
-				return -1;
-		fprintf(h, "} POSTPACK %s_t;\n\n", name);
+/* Parts end where a hash of the identifier of a message says so, about
+ * every 'split' messages, instead of after every 'split' messages. Adding or
+ * removing a message then only changes its own part, the others keep their
+ * contents and their names, those of their first message. Parts are cut
+ * after four times 'split' messages at the most. */
+static bool part_ends(const can_msg_t *msg, size_t length, unsigned split)
+{
+	assert(msg);
+	if (length >= 4u * split)
+		return true;
+	const uint64_t h = ((uint64_t)msg->id * 0x9E3779B97F4A7C15uLL) >> 32;
+	return (h % split) == 0;
+}
+
+/* Remove the parts a previous run listed in 'path' that are not in 'list' */
+static void parts_remove_stale(const char *path, const char *base, FILE *list)
+{
+	assert(path);
+	assert(base);
+	assert(list);
+	FILE *f = fopen(path, "rb");
+	if (!f)
+		return;
+	char *before = slurp(f), *now = slurp(list);
+	fclose(f);
+	const char *slash = strrchr(base, '/');
+	const int dir = slash ? (int)(slash - base + 1) : 0;
+	for (char *line = before ? strtok(before, "\n") : NULL; line && now; line = strtok(NULL, "\n")) {
+		const size_t len = strlen(line);
+		bool listed = false;
+		for (const char *p = strstr(now, line); p && !listed; p = strstr(p + 1, line))
+			listed = (p == now || p[-1] == '\n') && p[len] == '\n';
+		if (listed)
+			continue;
+		char *stale = allocate(dir + len + 1);
+		snprintf(stale, dir + len + 1, "%.*s%s", dir, base, line);
+		if (remove(stale) == 0)
+			note("removed stale part %s", stale);
+		free(stale);
 	}
-	return 0;
+	free(before);
+	free(now);
 }
 
-static char *msg2h_god_object(dbc_t *dbc, FILE *h, const char *name, dbc2c_options_t *copts)
+/* With '-m' the messages are generated into parts of about 'split' messages
+ * each (see part_ends) named '<base>_<first message>.c', the main C file keeps
+ * the dispatch functions and the helpers, which the parts only declare. Files
+ * are only written if they change, so that make only recompiles the parts of
+ * messages that did, and parts that are no longer generated are removed.
+ * '<base>.files' lists every C file to compile, one per line. */
+static int msgs2parts(dbc_t *dbc, const char *name, const char *base, size_t *budget, char *god, dbc2c_options_t *copts)
 {
-	assert(h);
 	assert(dbc);
+	assert(name);
+	assert(base);
+	assert(budget);
+	assert(god);
 	assert(copts);
-	char *object_name = duplicate(name);
-	const size_t object_name_len = strlen(object_name);
-	for (size_t i = 0; i < object_name_len; i++)
-		object_name[i] = (isalnum(object_name[i])) ?  tolower(object_name[i]) : '_';
-	fprintf(h, "typedef PREPACK struct {\n");
-	for (size_t i = 0; i < dbc->message_count; i++)
-		if (msg_data_type_time_stamp(h, dbc->messages[i], copts) < 0)
-			goto fail;
-	for (size_t i = 0; i < dbc->message_count; i++)
-		if (msg_data_type_bitfields(h, dbc->messages[i], copts) < 0)
-			goto fail;
-	for (size_t i = 0; i < dbc->message_count; i++)
-		if (msg_data_type(h, dbc->messages[i], false, copts) < 0)
-			goto fail;
-	fprintf(h, "} POSTPACK can_obj_%s_t;\n\n", object_name);
-	return object_name;
-fail:
-	free(object_name);
-	return NULL;
+	assert(copts->split);
+	const size_t base_len = strlen(base);
+	char *stem = duplicate(name);
+	char *dot = strrchr(stem, '.');
+	if (dot)
+		*dot = '\0';
+	char *path = allocate(base_len + MAX_NAME_LENGTH + 8);
+	FILE *list = tmpfile();
+	if (!list)
+		error("could not create temporary file: %s", emsg());
+	fprintf(list, "%s.c\n", stem);
+	int r = 0;
+	for (size_t i = 0, count = 0; r == 0 && i < dbc->message_count; i += count) {
+		can_msg_t **msgs = &dbc->messages[i];
+		for (count = 1; i + count < dbc->message_count; count++)
+			if (part_ends(msgs[count - 1], count, copts->split))
+				break;
+		char first[MAX_NAME_LENGTH] = {0};
+		make_name(first, MAX_NAME_LENGTH, msgs[0]->name, msgs[0]->id, copts);
+		snprintf(path, base_len + MAX_NAME_LENGTH + 8, "%s_%s.c", base, first);
+		fprintf(list, "%s_%s.c\n", stem, first);
+
+		FILE *part = tmpfile();
+		if (!part)
+			error("could not create temporary file: %s", emsg());
+		fputs("/* Generated by DBCC, see <https://github.com/howerj/dbcc> */\n", part);
+		fprintf(part, "#include \"%s\"\n", name);
+		includes2c(dbc, part, copts);
+		helpers2c(dbc, part, HELPERS_DECLARE_E, god, copts);
+		if (copts->share_layouts)
+			part_layout_prototypes(msgs, count, part, god, copts);
+		for (size_t j = 0; r == 0 && j < count; j++)
+			r = msg2c(msgs[j], part, budget, copts, god);
+		if (r == 0)
+			r = file_update(path, part);
+		fclose(part);
+	}
+	if (r == 0) {
+		snprintf(path, base_len + MAX_NAME_LENGTH + 8, "%s.files", base);
+		parts_remove_stale(path, base, list);
+		r = file_update(path, list);
+	}
+	fclose(list);
+	free(path);
+	free(stem);
+	return r;
 }
 
-int dbc2c(dbc_t *dbc, FILE *c, FILE *h, const char *name, dbc2c_options_t *copts)
+int dbc2c(dbc_t *dbc, FILE *c, FILE *h, const char *name, const char *base, dbc2c_options_t *copts)
 {
 	assert(dbc);
 	assert(c);
 	assert(h);
 	assert(name);
+	assert(base);
 	assert(copts);
 	int rv = 0;
 	time_t rawtime = time(NULL);
@@ -930,6 +5696,11 @@ int dbc2c(dbc_t *dbc, FILE *c, FILE *h, const char *name, dbc2c_options_t *copts
 	char *god = NULL;
 	char *file_guard = duplicate(name);
 	const size_t file_guard_len = strlen(file_guard);
+	dbc_t *pruned = NULL, *full = dbc;
+	filters_t *filters = NULL;
+
+	if (copts->node)
+		dbc = pruned = dbc_prune(dbc, copts);
 
 	/* make file guard all upper case alphanumeric only, first character
 	 * alpha only*/
@@ -945,26 +5716,43 @@ int dbc2c(dbc_t *dbc, FILE *c, FILE *h, const char *name, dbc2c_options_t *copts
 	for (size_t i = 0; i < dbc->message_count; i++) {
 		can_msg_t *msg = dbc->messages[i];
 		qsort(msg->sigs, msg->signal_count, sizeof(msg->sigs[0]), signal_compare_function);
+		if (msg_wire_layout(msg, copts))
+			debug("%s laid out in frame order", msg->name);
 	}
 
+	if (copts->profile)
+		profile_apply(dbc, copts->profile);
+
+	if (copts->share_layouts)
+		msg_layouts(dbc, copts);
+
 	/* header file (begin) */
 	fprintf(h, "/** CAN message encoder/decoder: automatically generated - do not edit\n");
 	if (copts->use_time_stamps)
 		fprintf(h, "  * @note  Generated on %s", asctime(timeinfo));
+	if (copts->node)
+		fprintf(h, "  * @note  Generated for node %s\n", copts->node);
 
 	fprintf(h,
 		"  * Generated by dbcc: See https://github.com/howerj/dbcc */\n"
 		"#ifndef %s\n"
 		"#define %s\n\n"
 		"#include <stdint.h>\n"
-		"%s\n\n"
-		"#ifdef __cplusplus\n"
-		"extern \"C\" { \n"
-		"#endif\n\n",
+		"%s%s\n\n",
 		file_guard,
 		file_guard,
+		copts->use_cache_layout || copts->generate_format || copts->generate_serialize || copts->generate_registry ? "#include <stddef.h>\n" : "",
 		copts->generate_print   ? "#include <stdio.h>"  : "");
 
+	if (copts->header_only && copts->generate_asserts) /* the inline accessors assert their arguments */
+		fprintf(h, "#include <assert.h>\n\n");
+
+	fputs(
+		"#ifdef __cplusplus\n"
+		"extern \"C\" { \n"
+		"#endif\n\n",
+		h);
+
 	fprintf(h, "#ifndef PREPACK\n");
 	fprintf(h, "#define PREPACK\n");
 	fprintf(h, "#endif\n\n");
@@ -973,11 +5761,91 @@ int dbc2c(dbc_t *dbc, FILE *c, FILE *h, const char *name, dbc2c_options_t *copts
 	fprintf(h, "#define POSTPACK\n");
 	fprintf(h, "#endif\n\n");
 
+	if (copts->use_unions) { /* anonymous unions and structures are C11 */
+		fprintf(h, "#ifndef DBCC_ANONYMOUS\n");
+		fprintf(h, "#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)\n");
+		fprintf(h, "#define DBCC_ANONYMOUS\n");
+		fprintf(h, "#elif defined(__GNUC__) || defined(__clang__)\n");
+		fprintf(h, "#define DBCC_ANONYMOUS __extension__\n");
+		fprintf(h, "#else\n");
+		fprintf(h, "#define DBCC_ANONYMOUS\n");
+		fprintf(h, "#endif\n");
+		fprintf(h, "#endif\n\n");
+	}
+
+	if (copts->use_cache_layout) {
+		fprintf(h, "#ifndef DBCC_CACHE_LINE\n");
+		fprintf(h, "#define DBCC_CACHE_LINE %u\n", CACHE_LINE_BYTES);
+		fprintf(h, "#endif\n\n");
+
+		fprintf(h, "#ifndef DBCC_CACHE_ALIGNED\n");
+		fprintf(h, "#if defined(__GNUC__) || defined(__clang__)\n");
+		fprintf(h, "#define DBCC_CACHE_ALIGNED __attribute__((aligned(DBCC_CACHE_LINE)))\n");
+		fprintf(h, "#elif defined(_MSC_VER)\n");
+		fprintf(h, "#define DBCC_CACHE_ALIGNED __declspec(align(DBCC_CACHE_LINE))\n");
+		fprintf(h, "#else\n");
+		fprintf(h, "#define DBCC_CACHE_ALIGNED\n");
+		fprintf(h, "#endif\n");
+		fprintf(h, "#endif\n\n");
+
+		fprintf(h, "#ifndef DBCC_STATIC_ASSERT\n");
+		fprintf(h, "#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)\n");
+		fprintf(h, "#define DBCC_STATIC_ASSERT(EXPR, TAG) _Static_assert(EXPR, #TAG)\n");
+		fprintf(h, "#else\n");
+		fprintf(h, "#define DBCC_STATIC_ASSERT(EXPR, TAG) typedef char dbcc_static_assert_ ## TAG[(EXPR) ? 1 : -1]\n");
+		fprintf(h, "#endif\n");
+		fprintf(h, "#endif\n\n");
+	}
+
+	if (copts->use_sequence_counter) { /* a full barrier, define it for other compilers */
+		fprintf(h, "#ifndef DBCC_SEQ_BARRIER\n");
+		fprintf(h, "#if defined(__GNUC__) || defined(__clang__)\n");
+		fprintf(h, "#define DBCC_SEQ_BARRIER() __sync_synchronize()\n");
+		fprintf(h, "#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_ATOMICS__)\n");
+		fprintf(h, "#include <stdatomic.h>\n");
+		fprintf(h, "#define DBCC_SEQ_BARRIER() atomic_thread_fence(memory_order_seq_cst)\n");
+		fprintf(h, "#else\n");
+		fprintf(h, "#error \"define DBCC_SEQ_BARRIER() as a full memory barrier for this compiler\"\n");
+		fprintf(h, "#endif\n");
+		fprintf(h, "#endif\n\n");
+		/* a write makes an even counter odd until it is done, within a
+		 * write that has already done so (such as 'set_group') it is left */
+		fprintf(h, "#ifndef DBCC_SEQ_WRITE\n");
+		fprintf(h, "#define DBCC_SEQ_WRITE(SEQ, STATEMENT) do {\\\n");
+		fprintf(h, "\tconst unsigned dbcc_seq = (SEQ);\\\n");
+		fprintf(h, "\tif (!(dbcc_seq & 1u)) {\\\n\t\t(SEQ) = dbcc_seq + 1u;\\\n\t\tDBCC_SEQ_BARRIER();\\\n\t}\\\n");
+		fprintf(h, "\tSTATEMENT;\\\n");
+		fprintf(h, "\tif (!(dbcc_seq & 1u)) {\\\n\t\tDBCC_SEQ_BARRIER();\\\n\t\t(SEQ) = dbcc_seq + 2u;\\\n\t}\\\n");
+		fprintf(h, "} while (0)\n");
+		fprintf(h, "#endif\n\n");
+	}
+
+	if (copts->profile) { /* rarely received messages go to the cold text section */
+		fprintf(h, "#ifndef DBCC_COLD\n");
+		fprintf(h, "#if defined(__GNUC__) || defined(__clang__)\n");
+		fprintf(h, "#define DBCC_COLD __attribute__((cold))\n");
+		fprintf(h, "#else\n");
+		fprintf(h, "#define DBCC_COLD\n");
+		fprintf(h, "#endif\n");
+		fprintf(h, "#endif\n\n");
+	}
+
 	fprintf(h, "#ifndef DBCC_TIME_STAMP\n");
 	fprintf(h, "#define DBCC_TIME_STAMP\n");
 	fprintf(h, "typedef uint32_t dbcc_time_stamp_t; /* Time stamp for message; you decide on units */\n");
 	fprintf(h, "#endif\n\n");
 
+	if (copts->generate_serialize) {
+		fprintf(h, "#ifndef DBCC_SERIALIZE_ENUM\n");
+		fprintf(h, "#define DBCC_SERIALIZE_ENUM\n");
+		fprintf(h, "typedef enum {\n");
+		fprintf(h, "\tDBCC_SERIALIZE_JSON_E = 0, /* One JSON object per line (NDJSON) */\n");
+		fprintf(h, "\tDBCC_SERIALIZE_CSV_E  = 1, /* Time stamp, ID, then one column per signal */\n");
+		fprintf(h, "\tDBCC_SERIALIZE_BIN_E  = 2, /* Little endian time stamp, ID and raw signal values */\n");
+		fprintf(h, "} dbcc_serialize_e;\n");
+		fprintf(h, "#endif\n\n");
+	}
+
 	fprintf(h, "#ifndef DBCC_STATUS_ENUM\n");
 	fprintf(h, "#define DBCC_STATUS_ENUM\n");
 	fprintf(h, "typedef enum {\n");
@@ -987,13 +5855,26 @@ int dbc2c(dbc_t *dbc, FILE *c, FILE *h, const char *name, dbc2c_options_t *copts
 	fprintf(h, "} dbcc_signal_status_e;\n");
 	fprintf(h, "#endif\n\n");
 
-	if (msg2h_types(dbc, h, copts) < 0) {
+	god = god_object_name(name);
+	if (copts->use_msg_switches) {
+		msg_switches2h(dbc, h, god, copts);
+		if (msg_switches_template(dbc, name, base, god, copts) < 0) {
+			rv = -1;
+			goto fail;
+		}
+	}
+
+	if (msg2h_types(dbc, h, god, copts) < 0) {
+		rv = -1;
+		goto fail;
+	}
+
+	if (msg2h_god_object(dbc, h, god, copts) < 0) {
 		rv = -1;
 		goto fail;
 	}
 
-	god = msg2h_god_object(dbc, h, name, copts);
-	if (!god) {
+	if (copts->generate_registry && msg2h_registry(dbc, h, god, copts) < 0) {
 		rv = -1;
 		goto fail;
 	}
@@ -1007,44 +5888,72 @@ int dbc2c(dbc_t *dbc, FILE *c, FILE *h, const char *name, dbc2c_options_t *copts
 	if (copts->generate_print)
 		switch_function_print(h, dbc, true, god, copts);
 
+	if (copts->generate_format)
+		switch_function_format(h, dbc, true, god, copts);
+
+	if (copts->generate_serialize)
+		switch_function_serialize(h, dbc, true, god, copts);
+
+	if (copts->generate_registry)
+		registry_functions(h, dbc, true, god, copts);
+
+	if (copts->filter_banks && (filters = filters_new(dbc, full, copts)))
+		filters2h(filters, h, god);
+
 	fputs("\n", h);
 
-	for (size_t i = 0; i < dbc->message_count; i++)
-		if (msg2h(dbc->messages[i], h, copts, god) < 0)
-			return -1;
+	size_t table_budget = copts->table_budget;
+	if (copts->header_only && copts->share_layouts && layouts2raw(dbc, h, god, &table_budget, copts) < 0) {
+		rv = -1;
+		goto fail;
+	}
 
-	fputs(
-		"#ifdef __cplusplus\n"
-		"} \n"
-		"#endif\n\n"
-		"#endif\n",
-		h);
-	/* header file (end) */
+	for (size_t i = 0; i < dbc->message_count; i++)
+		if (msg2h(dbc->messages[i], h, &table_budget, copts, god) < 0) {
+			rv = -1;
+			goto fail;
+		}
 
-	/* C FILE */
+	/* C FILE, with '-H' it only selects the implementation in the header */
 	fputs("/* Generated by DBCC, see <https://github.com/howerj/dbcc> */\n", c);
-	fprintf(c, "#include \"%s\"\n", name);
-	fprintf(c, "#include <inttypes.h>\n");
-	if (dbc->use_float)
-		fprintf(c, "#include <math.h> /* uses macros NAN, INFINITY, signbit, no need for -lm */\n");
-	if (copts->generate_asserts)
-		fprintf(c, "#include <assert.h>\n");
-	fputc('\n', c);
-	fprintf(c, "#define UNUSED(X) ((void)(X))\n\n");
-	fputs(cfunctions, c);
-	if (copts->generate_print)
-		fputs(cfunctions_print_only, c);
+	if (copts->header_only) {
+		fprintf(c, "#define %s_IMPLEMENTATION\n", file_guard);
+		fprintf(c, "#include \"%s\"\n", name);
+		fprintf(h, "#ifdef %s_IMPLEMENTATION\n\n", file_guard);
+		c = h;
+		includes2c(dbc, c, copts);
+		helpers2c(dbc, c, HELPERS_STATIC_E, god, copts);
+	} else {
+		fprintf(c, "#include \"%s\"\n", name);
+		includes2c(dbc, c, copts);
+		helpers2c(dbc, c, copts->split ? HELPERS_DEFINE_E : HELPERS_STATIC_E, god, copts);
+	}
+
+	if (copts->share_layouts && layouts2c(dbc, c, god, copts) < 0) {
+		rv = -1;
+		goto fail;
+	}
 
-	if (copts->generate_unpack && dbc->use_float)
-		fputs(float_unpack, c);
-	if (copts->generate_pack && dbc->use_float)
-		fputs(float_pack, c);
+	if (copts->share_layouts && !copts->header_only && layouts2raw(dbc, c, god, &table_budget, copts) < 0) {
+		rv = -1;
+		goto fail;
+	}
 
-	for (size_t i = 0; i < dbc->message_count; i++)
-		if (msg2c(dbc->messages[i], c, copts, god) < 0) {
+	if (copts->split) {
+		for (size_t i = 0; i < dbc->message_count; i++)
+			msg2prototypes(dbc->messages[i], c, god, copts);
+		fputc('\n', c);
+		if (msgs2parts(dbc, name, base, &table_budget, god, copts) < 0) {
 			rv = -1;
 			goto fail;
 		}
+	} else {
+		for (size_t i = 0; i < dbc->message_count; i++)
+			if (msg2c(dbc->messages[i], c, &table_budget, copts, god) < 0) {
+				rv = -1;
+				goto fail;
+			}
+	}
 
 	if (copts->generate_unpack)
 		switch_function(c, dbc, "unpack", true, false, "uint64_t", true, god, copts);
@@ -1055,7 +5964,35 @@ int dbc2c(dbc_t *dbc, FILE *c, FILE *h, const char *name, dbc2c_options_t *copts
 	if (copts->generate_print)
 		switch_function_print(c, dbc, false, god, copts);
 
+	if (copts->generate_format)
+		switch_function_format(c, dbc, false, god, copts);
+
+	if (copts->generate_serialize)
+		switch_function_serialize(c, dbc, false, god, copts);
+
+	if (copts->generate_registry)
+		registry_functions(c, dbc, false, god, copts);
+
+	if (filters && filters2c(filters, c, god) < 0)
+		rv = -1;
+
+	if (copts->generate_report && report2csv(dbc, base, copts) < 0)
+		rv = -1;
+
+	if (copts->header_only)
+		fprintf(h, "#endif /* %s_IMPLEMENTATION */\n\n", file_guard);
+
+	fputs(
+		"#ifdef __cplusplus\n"
+		"} \n"
+		"#endif\n\n"
+		"#endif\n",
+		h);
+	/* header file (end) */
 fail:
+	dbc_arrays_free(dbc);
+	filters_delete(filters);
+	dbc_prune_delete(pruned);
 	free(file_guard);
 	free(god);
 	return rv;
@@ -14,9 +14,30 @@ typedef struct {
 	bool use_doubles_for_encoding;
 	bool generate_print, generate_pack, generate_unpack;
 	bool generate_asserts;
+	bool generate_repack;  /* in place read-modify-write of packed frames */
+	bool generate_format;  /* buffer based formatting, print wraps it */
+	bool generate_serialize; /* JSON/CSV/binary serializers for decoded frames */
+	bool use_cache_layout; /* co-locate per message state, hottest first */
+	bool use_bmi2;         /* PEXT/PDEP pack/unpack selected at run time */
+	bool use_32bit_words;  /* pack/unpack with 32-bit halves of the frame */
+	bool use_overlay;      /* memcpy byte aligned signals, aligned messages in frame order */
+	size_t table_budget;   /* bytes of decode lookup tables, 0 disables them */
+	bool use_arrays;       /* numbered signals become arrays, moved by a loop */
+	bool use_unions;       /* multiplexed signals share storage in a union */
+	bool use_sequence_counter; /* per message counter for torn-read safe signal groups */
+	bool generate_registry; /* per message enable bits and receive callbacks */
+	size_t filter_banks;   /* acceptance filters to synthesize, 0 for none */
+	const char *profile;   /* bus log or frequency file to order/lay out by, or NULL */
+	bool share_layouts;    /* messages with identical structures share pack/unpack */
+	bool header_only;      /* static inline accessors, the rest behind a guard, in the header */
+	size_t split;          /* messages per generated C file, 0 for a single file */
+	bool use_msg_switches; /* every message behind an '#if', to compile it out */
+	bool generate_report;  /* worst case operation counts and sizes per message */
+	const char *cost_model; /* cycles and bytes per operation for the report, or NULL */
+	const char *node;      /* only generate code for this ECU, NULL for all */
 } dbc2c_options_t;
 
-int dbc2c(dbc_t *dbc, FILE *c, FILE *h, const char *name, dbc2c_options_t *copts);
+int dbc2c(dbc_t *dbc, FILE *c, FILE *h, const char *name, const char *base, dbc2c_options_t *copts);
 
 #ifdef __cplusplus
 }
@@ -27,6 +27,8 @@ static void signal_delete(signal_t *signal)
 		free(signal->attributes->attribute[i]);
 	
 	free(signal->name);
+	free(signal->multiplexor_name);
+	free(signal->mux_ranges);
 	free(signal->ecus);
 	free(signal->units);
 	free(signal->comment);
@@ -47,6 +49,12 @@ static void can_msg_delete(can_msg_t *msg)
 
 	for(int i = 0; i < msg->attributes->attribute_value_count; i++)
 		free(msg->attributes->attribute[i]);
+	for(size_t i = 0; i < msg->group_count; i++) {
+		free(msg->groups[i]->name);
+		free(msg->groups[i]->sigs);
+		free(msg->groups[i]);
+	}
+	free(msg->groups);
 	free(msg->sigs);
 	free(msg->name);
 	free(msg->ecu);
@@ -188,6 +196,12 @@ static signal_t *ast2signal(mpc_ast_t *top, mpc_ast_t *ast, unsigned can_id)
 	if (multiplex) {
 		sig->is_multiplexed = true;
 		sig->switchval = atol(multiplex->children[1]->contents);
+		sig->mux_ranges = allocate(sizeof(*sig->mux_ranges));
+		sig->mux_ranges[0].lo = sig->switchval;
+		sig->mux_ranges[0].hi = sig->switchval;
+		sig->mux_range_count = 1;
+		/* 'm<N>M', extended multiplexing; multiplexed and a multiplexor */
+		sig->is_multiplexor = !strcmp(multiplex->children[multiplex->children_num - 1]->contents, "M");
 	}
 
 	if (mpc_ast_get_child(ast, "multiplexor|char")) {
@@ -365,6 +379,126 @@ void assign_comment_to_message(dbc_t *dbc, const char *comment, unsigned message
 	}
 }
 
+/* SG_MUL_VAL_ <id> <signal> <multiplexor> <lo>-<hi>, ... ; names the
+ * multiplexor and the ranges of its values that select a signal, which is
+ * how extended (nested and ranged) multiplexing is described */
+static void ast2mul_val(dbc_t *dbc, mpc_ast_t *ast)
+{
+	assert(dbc);
+	assert(ast);
+	mpc_ast_t *id = mpc_ast_get_child(ast, "id|integer|regex");
+	const int signal_index = mpc_ast_get_index_lb(ast, "name|ident|regex", 0);
+	const int multiplexor_index = mpc_ast_get_index_lb(ast, "name|ident|regex", signal_index + 1);
+	assert(id && signal_index >= 0 && multiplexor_index >= 0);
+	const char *signal_name = ast->children[signal_index]->contents;
+	const char *multiplexor_name = ast->children[multiplexor_index]->contents;
+	unsigned long message_id = 0;
+	int r = sscanf(id->contents, "%lu", &message_id);
+	assert(r == 1);
+
+	signal_t *sig = NULL, *multiplexor = NULL;
+	for (size_t i = 0; i < dbc->message_count; i++) {
+		can_msg_t *msg = dbc->messages[i];
+		if (msg->id != message_id)
+			continue;
+		for (size_t j = 0; j < msg->signal_count; j++) {
+			if (!strcmp(msg->sigs[j]->name, signal_name))
+				sig = msg->sigs[j];
+			if (!strcmp(msg->sigs[j]->name, multiplexor_name))
+				multiplexor = msg->sigs[j];
+		}
+	}
+	if (!sig || !multiplexor || sig == multiplexor || !sig->is_multiplexed || !multiplexor->is_multiplexor) {
+		warning("SG_MUL_VAL_ %lu %s %s ignored, no such multiplexed signal and multiplexor", message_id, signal_name, multiplexor_name);
+		return;
+	}
+
+	mux_range_t *ranges = allocate(sizeof(*ranges) * (ast->children_num + 1));
+	size_t count = 0;
+	for(int i = 0; i >= 0;) {
+		i = mpc_ast_get_index_lb(ast, "mul_range|>", i);
+		if (i >= 0) {
+			mpc_ast_t *range = mpc_ast_get_child_lb(ast, "mul_range|>", i);
+			const int lo = mpc_ast_get_index_lb(range, "regex", 0);
+			const int hi = mpc_ast_get_index_lb(range, "regex", lo + 1);
+			assert(lo >= 0 && hi >= 0);
+			r = sscanf(range->children[lo]->contents, "%u", &ranges[count].lo);
+			assert(r == 1);
+			r = sscanf(range->children[hi]->contents, "%u", &ranges[count].hi);
+			assert(r == 1);
+			if (ranges[count].lo <= ranges[count].hi)
+				count++;
+			else
+				warning("SG_MUL_VAL_ %lu %s has an empty range", message_id, signal_name);
+			i++;
+		}
+	}
+	if (!count) {
+		free(ranges);
+		return;
+	}
+	free(sig->multiplexor_name);
+	free(sig->mux_ranges);
+	sig->multiplexor_name = duplicate(multiplexor_name);
+	sig->mux_ranges = ranges;
+	sig->mux_range_count = count;
+	sig->switchval = ranges[0].lo;
+	debug("%s selected by %s (%zu ranges)", sig->name, multiplexor_name, count);
+}
+
+/* SIG_GROUP_ <id> <group> <repetitions> : <signal>* ; names a set of
+ * signals of a message that belong together and should be read and written
+ * as one */
+static void ast2sig_group(dbc_t *dbc, mpc_ast_t *ast)
+{
+	assert(dbc);
+	assert(ast);
+	mpc_ast_t *id = mpc_ast_get_child(ast, "id|integer|regex");
+	mpc_ast_t *repetitions = mpc_ast_get_child(ast, "integer|regex");
+	const int group_index = mpc_ast_get_index_lb(ast, "name|ident|regex", 0);
+	assert(id && repetitions && group_index >= 0);
+	const char *group_name = ast->children[group_index]->contents;
+	unsigned long message_id = 0;
+	int r = sscanf(id->contents, "%lu", &message_id);
+	assert(r == 1);
+
+	can_msg_t *msg = NULL;
+	for (size_t i = 0; i < dbc->message_count; i++)
+		if (dbc->messages[i]->id == message_id)
+			msg = dbc->messages[i];
+	if (!msg) {
+		warning("SIG_GROUP_ %lu %s ignored, no such message", message_id, group_name);
+		return;
+	}
+
+	signal_group_t *group = allocate(sizeof(*group));
+	group->name = duplicate(group_name);
+	group->sigs = allocate(sizeof(*group->sigs) * (ast->children_num + 1));
+	r = sscanf(repetitions->contents, "%u", &group->repetitions);
+	assert(r == 1);
+	for(int i = group_index + 1; i >= 0;) {
+		i = mpc_ast_get_index_lb(ast, "name|ident|regex", i);
+		if (i >= 0) {
+			const char *signal_name = ast->children[i]->contents;
+			signal_t *sig = NULL;
+			for (size_t j = 0; j < msg->signal_count; j++)
+				if (!strcmp(msg->sigs[j]->name, signal_name))
+					sig = msg->sigs[j];
+			for (size_t j = 0; sig && j < group->signal_count; j++)
+				if (group->sigs[j] == sig)
+					sig = NULL;
+			if (sig)
+				group->sigs[group->signal_count++] = sig;
+			else
+				warning("SIG_GROUP_ %lu %s: no such signal %s, or it is listed twice", message_id, group_name, signal_name);
+			i++;
+		}
+	}
+	msg->groups = reallocator(msg->groups, sizeof(*msg->groups) * (msg->group_count + 1));
+	msg->groups[msg->group_count++] = group;
+	debug("%s: signal group %s (%zu signals)", msg->name, group_name, group->signal_count);
+}
+
 void SetAttributeDefaultValue(attribute_value *attribute)
 {
 	mpc_ast_t *value;
@@ -781,6 +915,22 @@ dbc_t *ast2dbc(mpc_ast_t *ast)
 	if (i >= 0)
 		d->use_float = true;
 
+	for (int i = 0; i >= 0;) {
+		i = mpc_ast_get_index_lb(ast, "sig_group|>", i);
+		if (i >= 0) {
+			ast2sig_group(d, mpc_ast_get_child_lb(ast, "sig_group|>", i));
+			i++;
+		}
+	}
+
+	for (int i = 0; i >= 0;) {
+		i = mpc_ast_get_index_lb(ast, "mul_val|>", i);
+		if (i >= 0) {
+			ast2mul_val(d, mpc_ast_get_child_lb(ast, "mul_val|>", i));
+			i++;
+		}
+	}
+
 	// find and store the vals into the dbc: they will be assigned to
 	// signals later
 	mpc_ast_t *comments_ast = mpc_ast_get_child_lb(ast, "comments|>", 0);
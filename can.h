@@ -115,6 +115,11 @@ typedef struct {
 	char *name;
 } val_list_t;
 
+typedef struct {
+	unsigned lo;         /**< lowest multiplexor value, inclusive */
+	unsigned hi;         /**< highest multiplexor value, inclusive */
+} mux_range_t;
+
 typedef struct {
 	size_t ecu_count;    /**< ECU count */
 	char *units;         /**< units used */
@@ -133,19 +138,37 @@ typedef struct {
 	bool is_multiplexor; /**< true if this is a multiplexor */
 	bool is_multiplexed; /**< true if this is a multiplexed signal */
 	unsigned switchval;  /**< if is_multiplexed, this will contain the value that decodes this signal for the multiplexor */
+	char *multiplexor_name;  /**< if is_multiplexed, the multiplexor named by SG_MUL_VAL_, NULL for the message multiplexor */
+	size_t mux_range_count;  /**< if is_multiplexed, number of ranges of multiplexor values that decode this signal */
+	mux_range_t *mux_ranges; /**< if is_multiplexed, the ranges; just 'switchval' unless given by SG_MUL_VAL_ */
 	attribute_values * attributes;
 	val_list_t *val_list;
 	char *comment;
 } signal_t;
 
 typedef struct {
+	char *name;          /**< name of the signal group */
+	unsigned repetitions; /**< repetitions of the group, as given in the DBC */
+	size_t signal_count; /**< number of signals in the group */
+	signal_t **sigs;     /**< signals in the group, these belong to the message */
+} signal_group_t;
+
+typedef struct can_msg {
 	char *name;          /**< can message name */
 	char *ecu;           /**< name of ECU */
 	signal_t **sigs;     /**< signals that can decode/encode this message*/
 	uint64_t data;       /**< data, up to eight bytes, not used for generation */
 	size_t signal_count; /**< number of signals */
+	size_t group_count;  /**< number of signal groups */
+	signal_group_t **groups; /**< signal groups, from SIG_GROUP_ */
 	unsigned dlc;        /**< length of CAN message 0-8 bytes */
 	unsigned long id;    /**< identifier, 11 or 29 bit */
+	bool profiled;       /**< true if a bus profile was applied, 'share' is then valid */
+	double share;        /**< if profiled, fraction of the profiled frames with this identifier */
+	struct can_msg *layout; /**< message whose pack/unpack functions this one shares, itself for the first, NULL if none */
+	struct signal_array *arrays; /**< arrays of numbered signals, found once by the C generator */
+	size_t array_count;  /**< number of arrays, valid if 'arrays_found' */
+	bool arrays_found;   /**< true once the C generator has looked for arrays */
 	attribute_values * attributes;
 	char *comment;
 } can_msg_t;
@@ -26,7 +26,7 @@ typedef enum {
 static void usage(const char *arg0)
 {
 	assert(arg0);
-	fprintf(stderr, "%s: [-] [-hvjgtxpkuDC] [-o dir] file*\n", arg0);
+	fprintf(stderr, "%s: [-] [-hvjgtxpkuDClrfSBwOaUqRdHcW] [-L bytes] [-F banks] [-P file] [-m count] [-K file] [-n node] [-o dir] file*\n", arg0);
 }
 
 static void help(void)
@@ -50,6 +50,27 @@ Options:\n\
 \t-k     generate only pack code\n\
 \t-u     generate only unpack code\n\
 \t-s     disable assert generation\n\
+\t-l     cache line aware layout of the generated CAN object\n\
+\t-n node only generate code for messages a node sends or receives\n\
+\t-r     generate repack/patch functions to modify packed frames in place\n\
+\t-f     generate format functions that print into a buffer\n\
+\t-S     generate JSON, CSV and binary serializers for decoded messages\n\
+\t-B     generate BMI2 (PEXT/PDEP) pack/unpack, selected at run time\n\
+\t-w     pack/unpack using 32-bit words, for targets with slow 64-bit shifts\n\
+\t-O     copy byte aligned Intel signals with memcpy, laying out fully aligned messages in frame order\n\
+\t-L bytes decode small scaled signals with lookup tables, up to 'bytes' in total\n\
+\t-F banks synthesize acceptance filters (1 to 32 mask/ID pairs) for received messages\n\
+\t-P file  order dispatch and layout by a candump log or 'id count' frequency file\n\
+\t-a     turn numbered signals (Cell_1, Cell_2, ...) into arrays\n\
+\t-U     store multiplexed signals in a union, one member per multiplexor value\n\
+\t-q     add a sequence counter to each message, signal groups are read without tearing\n\
+\t-R     generate a registry to enable messages and subscribe to them\n\
+\t-d     share pack/unpack and conversions between messages with the same layout\n\
+\t-H     header only, accessors are static inline and the rest is behind a guard\n\
+\t-m count write about 'count' messages per C file, listed in a '.files' file, for parallel builds\n\
+\t-c     put each message behind an '#if' switch so builds can compile it out\n\
+\t-W     estimate operation counts, cycles and sizes per message in '<file>_cost.csv'\n\
+\t-K file cycles and bytes per operation ('operation cycles [bytes]' or 'word 64' lines) for the report, implies -W\n\
 \tfile   process a DBC file\n\
 \n\
 Files must come after the arguments have been processed.\n\
@@ -86,14 +107,27 @@ static int dbc2cWrapper(dbc_t *dbc, const char *dbc_file, const char *file_only,
 	char *cname = replace_file_type(dbc_file,  "c");
 	char *hname = replace_file_type(dbc_file,  "h");
 	char *fname = replace_file_type(file_only, "h");
-	FILE *c = fopen_or_die(cname, "wb");
-	FILE *h = fopen_or_die(hname, "wb");
-	const int r = dbc2c(dbc, c, h, fname, copts);
+	char *base = duplicate(cname);
+	base[strlen(base) - 2] = '\0'; /* remove ".c" */
+	FILE *c = tmpfile(), *h = tmpfile();
+	if (!c || !h)
+		error("could not create temporary file: %s", emsg());
+	int r = dbc2c(dbc, c, h, fname, base, copts);
+	if (r >= 0) { /* unchanged files keep their time stamps, so make does not rebuild them */
+		r = file_update(cname, c) < 0 ? -1 : r;
+		r = file_update(hname, h) < 0 ? -1 : r;
+	}
 	fclose(c);
 	fclose(h);
+	if (r < 0) { /* do not leave a truncated header or source file behind */
+		warning("removing %s and %s", cname, hname);
+		remove(cname);
+		remove(hname);
+	}
 	free(cname);
 	free(hname);
 	free(fname);
+	free(base);
 	return r;
 }
 
@@ -158,10 +192,31 @@ int main(int argc, char **argv)
 		.generate_pack             =  false,
 		.generate_unpack           =  false,
 		.generate_asserts          =  true,
+		.generate_repack           =  false,
+		.generate_format           =  false,
+		.generate_serialize        =  false,
+		.use_cache_layout          =  false,
+		.use_bmi2                  =  false,
+		.use_32bit_words           =  false,
+		.use_overlay               =  false,
+		.table_budget              =  0,
+		.use_arrays                =  false,
+		.use_unions                =  false,
+		.use_sequence_counter      =  false,
+		.generate_registry         =  false,
+		.filter_banks              =  0,
+		.profile                   =  NULL,
+		.share_layouts             =  false,
+		.header_only               =  false,
+		.split                     =  0,
+		.use_msg_switches          =  false,
+		.generate_report           =  false,
+		.cost_model                =  NULL,
+		.node                      =  NULL,
 	};
 	int opt = 0;
 
-	while ((opt = dbcc_getopt(argc, argv, "hVvbjgxCNtDpukso:")) != -1) {
+	while ((opt = dbcc_getopt(argc, argv, "hVvbjgxCNtDpukslrfSBwOaUqRdHcWL:F:P:m:K:n:o:")) != -1) {
 		switch (opt) {
 		case 'h':
 			usage(argv[0]);
@@ -219,6 +274,106 @@ int main(int argc, char **argv)
 			copts.generate_asserts = false;
 			debug("asserts disabled - apparently you think silent corruption is a good thing", outdir);
 			break;
+		case 'l':
+			copts.use_cache_layout = true;
+			debug("using cache line aware layout");
+			break;
+		case 'r':
+			copts.generate_repack = true;
+			debug("generate code for repack");
+			break;
+		case 'f':
+			copts.generate_format = true;
+			debug("generate code for format");
+			break;
+		case 'S':
+			copts.generate_serialize = true;
+			debug("generate code for serialization");
+			break;
+		case 'B':
+			copts.use_bmi2 = true;
+			debug("generate BMI2 pack/unpack");
+			break;
+		case 'w':
+			copts.use_32bit_words = true;
+			debug("using 32-bit words for pack/unpack");
+			break;
+		case 'O':
+			copts.use_overlay = true;
+			debug("copying byte aligned signals with memcpy");
+			break;
+		case 'a':
+			copts.use_arrays = true;
+			debug("using arrays for numbered signals");
+			break;
+		case 'U':
+			copts.use_unions = true;
+			debug("using unions for multiplexed signals");
+			break;
+		case 'q':
+			copts.use_sequence_counter = true;
+			debug("using sequence counters");
+			break;
+		case 'R':
+			copts.generate_registry = true;
+			debug("generate message registry");
+			break;
+		case 'd':
+			copts.share_layouts = true;
+			debug("sharing identical message layouts");
+			break;
+		case 'H':
+			copts.header_only = true;
+			debug("generating a header only library");
+			break;
+		case 'c':
+			copts.use_msg_switches = true;
+			debug("generating per message switches");
+			break;
+		case 'W':
+			copts.generate_report = true;
+			debug("generating a cost report");
+			break;
+		case 'K':
+			copts.cost_model = dbcc_optarg;
+			copts.generate_report = true;
+			debug("using cost model: %s", copts.cost_model);
+			break;
+		case 'L': {
+			char *end = NULL;
+			const unsigned long budget = strtoul(dbcc_optarg, &end, 0);
+			if (!*dbcc_optarg || *end)
+				error("invalid table budget: %s", dbcc_optarg);
+			copts.table_budget = budget;
+			debug("decode lookup table budget: %lu bytes", budget);
+			break;
+		}
+		case 'F': {
+			char *end = NULL;
+			const unsigned long banks = strtoul(dbcc_optarg, &end, 0);
+			if (!*dbcc_optarg || *end || banks < 1 || banks > 32)
+				error("invalid number of filter banks (1-32): %s", dbcc_optarg);
+			copts.filter_banks = banks;
+			debug("acceptance filter banks: %lu", banks);
+			break;
+		}
+		case 'P':
+			copts.profile = dbcc_optarg;
+			debug("using bus profile: %s", copts.profile);
+			break;
+		case 'm': {
+			char *end = NULL;
+			const unsigned long split = strtoul(dbcc_optarg, &end, 0);
+			if (!*dbcc_optarg || *end || split < 1)
+				error("invalid number of messages per file: %s", dbcc_optarg);
+			copts.split = split;
+			debug("messages per C file: %lu", split);
+			break;
+		}
+		case 'n':
+			copts.node = dbcc_optarg;
+			debug("generating code for node: %s", copts.node);
+			break;
 		default:
 			fprintf(stderr, "invalid options\n");
 			usage(argv[0]);
@@ -227,6 +382,9 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (copts.header_only && copts.split)
+		error("a header only library (-H) cannot be split (-m)");
+
 	if (!copts.generate_unpack && !copts.generate_pack && !copts.generate_print) {
 		copts.generate_print  = true;
 		copts.generate_pack   = true;
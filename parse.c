@@ -57,6 +57,9 @@ static mpc_ast_t *_parse_dbc_file_by_handle(const char *name, FILE *handle);
 	X(comment,              			"comment")\
 	X(comments,             			"comments")\
 	X(comment_string,       			"comment_string")\
+	X(sig_group,            			"sig_group")\
+	X(mul_range,            			"mul_range")\
+	X(mul_val,              			"mul_val")\
 	X(dbc,                  			"dbc")
 
 static const char *dbc_grammar =
@@ -81,7 +84,7 @@ static const char *dbc_grammar =
 " ecu                  : <ident> ; \n"
 " dlc                  : <integer> ; \n"
 " id                   : <integer> ; \n"
-" multiplexor          : 'M' | 'm' <s>* <integer> ; \n"
+" multiplexor          : 'M' | 'm' <s>* <integer> 'M'? ; \n"
 " signal               : <s>* \"SG_\" <s>+ <name> <s>* <multiplexor>? <s>* ':' <s>* <startbit> <s>* '|' <s>* \n"
 "                        <length> <s>* '@' <s>* <endianess> <s>* <sign> <s>* <y_mx_c> <s>* \n"
 "                        <range> <s>* <unit> <s>* <nodes> <s>* <n> ; \n"
@@ -131,6 +134,9 @@ static const char *dbc_grammar =
 "                        |    <comment_string> "
 "                        ) <s>* ';' <n>* ;\n "
 " comments              : <comment>* ; "
+" sig_group            : \"SIG_GROUP_\" <s>+ <id> <s>+ <name> <s>+ <integer> <s>* ':' (<s>* <name>)* <s>* ';' <n>* ; \n"
+" mul_range            : /[0-9]+/ <s>* '-' <s>* /[0-9]+/ ; \n"
+" mul_val              : \"SG_MUL_VAL_\" <s>+ <id> <s>+ <name> <s>+ <name> <s>+ <mul_range> (<s>* ',' <s>* <mul_range>)* <s>* ';' <n>* ; \n"
 /*DBC_file =
     version
     new_symbols
@@ -155,7 +161,7 @@ static const char *dbc_grammar =
 	signal_groups
 	signal_extended_value_type_list
 	extended_multiplexing ;*/
-" dbc       : <version> <symbols> <bs> <ecus> <values>* <n>* <messages> <message_sender>* <sigval>* <comments>  <attribute_definitions> <attribute_defaults> <attribute_values> <vals>; \n" ;
+" dbc       : <version> <symbols> <bs> <ecus> <values>* <n>* <messages> <message_sender>* <sigval>* <comments>  <attribute_definitions> <attribute_defaults> <attribute_values> <vals> <sig_group>* <mul_val>*; \n" ;
 
 const char *parse_get_grammar(void)
 {
@@ -0,0 +1,204 @@
+/* Benchmark for the code generated from a DBC file, see 'bench.sh'.
+ *
+ * A stream of random frames for the messages of the DBC file is unpacked,
+ * every signal is decoded and the messages are packed again. The time per
+ * frame (per signal for decoding) is printed for each, and on Linux the
+ * instructions and level 1 data cache misses as well, if the kernel allows
+ * them to be counted. Without counters the cache lines of the CAN object an
+ * unpack writes to stand in for the misses it causes once the object is no
+ * longer cached, they are printed on average and at most over the messages.
+ *
+ * Built like 'roundtrip.c', with 'decoders.h' generated from the header to
+ * call every decode function taking just the CAN object and a value, and
+ * 'DECODERS' defined as the number of them. '_GNU_SOURCE' has to be defined on
+ * the command line, as the header is included before this file. */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+	unsigned long id;
+	unsigned dlc;
+} frame_t;
+
+#include "frames.h"
+
+#define FRAME_COUNT (sizeof(frames) / sizeof(frames[0]))
+
+#ifndef STREAM
+#define STREAM (4096u)
+#endif
+
+#ifndef ROUNDS
+#define ROUNDS (200u)
+#endif
+
+#ifndef LINE
+#define LINE (64u)
+#endif
+
+static OBJ o;
+
+typedef struct {
+	int fd[2]; /* instructions, L1 data cache read misses, -1 if not counted */
+	long long count[2];
+	double ns;
+} counters_t;
+
+#ifdef __linux__
+static int counter_open(uint32_t type, uint64_t config)
+{
+	struct perf_event_attr a;
+	memset(&a, 0, sizeof(a));
+	a.type = type;
+	a.size = sizeof(a);
+	a.config = config;
+	a.disabled = 1;
+	a.exclude_kernel = 1;
+	a.exclude_hv = 1;
+	return syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+}
+#endif
+
+static void counters_start(counters_t *c)
+{
+	c->fd[0] = -1;
+	c->fd[1] = -1;
+#ifdef __linux__
+	c->fd[0] = counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	c->fd[1] = counter_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+			(PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	for (int i = 0; i < 2; i++)
+		if (c->fd[i] >= 0)
+			ioctl(c->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+#endif
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	c->ns = t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void counters_stop(counters_t *c)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	c->ns = (t.tv_sec * 1e9 + t.tv_nsec) - c->ns;
+	for (int i = 0; i < 2; i++) {
+		c->count[i] = -1;
+#ifdef __linux__
+		if (c->fd[i] < 0)
+			continue;
+		ioctl(c->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+		if (read(c->fd[i], &c->count[i], sizeof(c->count[i])) != sizeof(c->count[i]))
+			c->count[i] = -1;
+		close(c->fd[i]);
+#endif
+	}
+}
+
+static void counters_print(const char *name, const counters_t *c, double frames)
+{
+	printf("%-8s %8.1f ns", name, c->ns / frames);
+	for (int i = 0; i < 2; i++) {
+		if (c->count[i] < 0)
+			printf(" %10s", "n/a");
+		else
+			printf(" %10.1f", c->count[i] / frames);
+	}
+	putchar('\n');
+}
+
+/* Bytes of the object an unpack of 'data' writes are different from the
+ * fill of the object before it with either 0x00 or 0xff, the number of
+ * cache lines they are on is returned. Lines are counted from the start of
+ * the object, so that the count does not depend on where it was placed. */
+static unsigned lines_written(unsigned long id, uint64_t data)
+{
+	static unsigned char before[2][sizeof(OBJ)];
+	for (int i = 0; i < 2; i++) {
+		memset(&o, i ? 0xff : 0x00, sizeof(o));
+		unpack_message(&o, id, data, 8, 1);
+		memcpy(before[i], &o, sizeof(o));
+	}
+	size_t last = SIZE_MAX;
+	unsigned lines = 0;
+	for (size_t i = 0; i < sizeof(o); i++) {
+		if (before[0][i] == 0x00 && before[1][i] == 0xff)
+			continue;
+		const size_t line = i / LINE;
+		lines += line != last;
+		last = line;
+	}
+	return lines;
+}
+
+/* the object is reached through a volatile pointer so that decoding it is
+ * not moved out of the loop when the decode functions are inlined */
+static OBJ *volatile object = &o;
+
+static double decode_all(void)
+{
+	const OBJ *p = object;
+	double sum = 0;
+	long errors = 0;
+#include "decoders.h"
+	return sum + errors;
+}
+
+int main(void)
+{
+	static size_t which[STREAM];
+	static uint64_t data[STREAM];
+	uint64_t s = 88172645463325252uLL, packed = 0;
+	volatile double sink = 0;
+	for (size_t i = 0; i < STREAM; i++) {
+		s ^= s << 13;
+		s ^= s >> 7;
+		s ^= s << 17;
+		which[i] = (s >> 32) % FRAME_COUNT;
+		data[i] = s;
+	}
+	counters_t c;
+	unsigned long lines = 0, most = 0;
+	for (size_t i = 0; i < FRAME_COUNT; i++) {
+		const unsigned n = lines_written(frames[i].id, data[i % STREAM]);
+		lines += n;
+		most = n > most ? n : most;
+	}
+	memset(&o, 0, sizeof(o));
+	printf("lines    %8.2f avg %4lu max (of %u bytes, per unpack)\n", (double)lines / FRAME_COUNT, most, LINE);
+	printf("%-8s %11s %10s %10s\n", "", "time", "instr", "L1d miss");
+
+	counters_start(&c);
+	for (unsigned r = 0; r < ROUNDS; r++)
+		for (size_t i = 0; i < STREAM; i++)
+			unpack_message(&o, frames[which[i]].id, data[i], 8, i);
+	counters_stop(&c);
+	counters_print("unpack", &c, (double)ROUNDS * STREAM);
+
+	counters_start(&c);
+	for (unsigned r = 0; r < ROUNDS; r++)
+		sink += decode_all();
+	counters_stop(&c);
+	counters_print("decode", &c, (double)ROUNDS * (DECODERS ? DECODERS : 1));
+
+	counters_start(&c);
+	for (unsigned r = 0; r < ROUNDS; r++)
+		for (size_t i = 0; i < STREAM; i++) {
+			uint64_t d = 0;
+			pack_message(&o, frames[which[i]].id, &d);
+			packed ^= d;
+		}
+	counters_stop(&c);
+	counters_print("pack", &c, (double)ROUNDS * STREAM);
+	sink += packed;
+	return sink == 0.5; /* keep the results alive */
+}
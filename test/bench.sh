@@ -0,0 +1,117 @@
+#!/bin/sh
+# Benchmarks of the C code generator options, run by 'make bench'.
+#
+# The code generated for a DBC file (ex1.dbc by default) with each set of
+# options below is timed by 'bench.c', with '-H' 'decode' is the cost of an
+# access the compiler can inline into it. The default code is timed with the
+# byte swap intrinsics and without, the code of '-B' compiled with BMI2
+# enabled, and the code of '-w' in a 32-bit build. With '-m' the time taken
+# to compile the generated code is measured instead, in total and for the
+# largest file, which bounds a parallel build. Timing uses 'date +%s%N', as
+# found on Linux.
+set -u
+
+DBCC=${DBCC:-../dbcc}
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--std=c99 -O2 -fwrapv}
+OUT=${OUT:-out/bench}
+DBC=${1:-ex1}
+
+VARIANTS='
+default
+layout    -l
+bmi2      -B
+words     -w
+overlay   -O
+tables    -L 4096
+shared    -d
+arrays    -a
+header    -H
+'
+
+src=../$DBC.dbc
+test -f "$src" || src=$DBC.dbc
+mkdir -p "$OUT"
+awk '$1 == "BO_" {
+	id = $2; dlc = ($4 == ":") ? $5 : $4
+	if (id >= 2147483648) id -= 2147483648
+	printf "\t{ %.0f, %d },\n", id, dlc
+}' "$src" > "$OUT/frames.list"
+{ echo 'static const frame_t frames[] = {'; cat "$OUT/frames.list"; echo '};'; } > "$OUT/frames.h"
+
+now() {
+	date +%s%N
+}
+
+# bench name 'dbcc options' 'extra compiler options'
+bench() {
+	dir=$OUT/$1
+	rm -rf "$dir"
+	mkdir -p "$dir"
+	$DBCC $2 -o "$dir" "$src" < /dev/null > "$dir/dbcc.log" 2>&1 || { echo "$1: dbcc failed"; return; }
+	sed -n 's/^\(static inline \)\{0,1\}int \(decode_[A-Za-z0-9_]*\)(const can_obj_[A-Za-z0-9_]* \*o, \([A-Za-z0-9_]*\) \*out).*$/\t{ \3 v = 0; errors += \2(p, \&v) < 0; sum += (double)v; }/p' \
+		"$dir/$DBC.h" > "$dir/decoders.h"
+	obj=$(sed -n 's/^}.* \(can_obj_[A-Za-z0-9_]*_t\);$/\1/p' "$dir/$DBC.h" | head -1)
+	if ! $CC $CFLAGS $3 -c "$dir/$DBC.c" -o "$dir/$DBC.o" 2> "$dir/cc.log" ||
+		! $CC $CFLAGS $3 -D_GNU_SOURCE -I "$OUT" -I "$dir" -include "$dir/$DBC.h" -DOBJ="$obj" -DDECODERS="$(wc -l < "$dir/decoders.h")" \
+			bench.c "$dir/$DBC.o" -lm -o "$dir/bench" 2>> "$dir/cc.log"; then
+		echo "$1: compiling failed, see $dir/cc.log"
+		return
+	fi
+	echo "$DBC $1 $2 $3"
+	"$dir/bench" < /dev/null
+}
+
+while read -r name flags; do
+	test -n "$name" || continue
+	bench "$name" "$flags" ""
+done <<VARIANTS
+$VARIANTS
+VARIANTS
+
+# the byte swap intrinsics against the portable code they replace, compilers
+# recognise the portable code at some optimisation levels and not at others
+for level in -O2 -Os; do
+	bench "bswap$level" "" "$level"
+	bench "portable$level" "" "$level -DDBCC_NO_BUILTIN_BSWAP"
+done
+
+# '-B' without the run time check of the CPU, where the compiler has BMI2
+if echo 'int x;' | $CC -mbmi2 -x c -c -o /dev/null - 2> /dev/null; then
+	bench bmi2-mbmi2 -B -mbmi2
+else
+	echo "$DBC bmi2-mbmi2: skipped, $CC has no -mbmi2"
+fi
+
+# '-w' is meant for 32-bit targets, it is timed against the default code in
+# a 32-bit build where the compiler has the headers and libraries for one
+if printf '#include <stdio.h>\nint main(void) { return puts(""); }\n' | $CC -m32 -x c -o "$OUT/m32" - 2> /dev/null; then
+	bench default-m32 "" -m32
+	bench words-m32 -w -m32
+else
+	echo "$DBC words-m32: skipped, $CC cannot build 32-bit programs with -m32"
+fi
+
+# building the generated code as one file and split into files of 'count'
+# messages, the largest file bounds a build with enough parallel jobs
+for count in 0 25 5; do
+	dir=$OUT/split$count
+	rm -rf "$dir"
+	mkdir -p "$dir"
+	if [ "$count" -eq 0 ]; then
+		$DBCC -o "$dir" "$src" < /dev/null > /dev/null 2>&1
+		echo "$DBC.c" > "$dir/$DBC.files"
+	else
+		$DBCC -m "$count" -o "$dir" "$src" < /dev/null > /dev/null 2>&1
+	fi
+	total=0
+	largest=0
+	for c in $(cat "$dir/$DBC.files"); do
+		start=$(now)
+		$CC $CFLAGS -c "$dir/$c" -o "$dir/${c%.c}.o" 2> /dev/null
+		took=$(( ($(now) - start) / 1000000 ))
+		total=$((total + took))
+		[ "$took" -gt "$largest" ] && largest=$took
+	done
+	echo "$DBC build -m $count: $(wc -l < "$dir/$DBC.files") files, $total ms in total, $largest ms for the largest"
+done
@@ -0,0 +1,176 @@
+/* Test of the range checks of the decode and encode functions, see
+ * 'check.sh'.
+ *
+ * The raw values of a signal that decode to within its [minimum, maximum]
+ * are found with the arithmetic the decode functions use, the constants
+ * being those printed into the generated code. The lowest and highest of
+ * them, and the raw values just past them, are decoded and the results must
+ * agree with the range: the values in it are accepted and decode to the
+ * same value, those past it are rejected. Their physical values, and the
+ * minimum and maximum themselves if the signal can hold them, are encoded:
+ * a value that is accepted must encode to a raw value that decodes without
+ * an error, and the physical value of a valid raw value must encode back to
+ * it. The results are printed to be compared with the output for other
+ * options.
+ *
+ * Built with '-include' for the generated header and with 'bounds.h'
+ * generated from the DBC file and the header, a line for each signal:
+ *
+ *	BOUNDS(decode function, encode function, type decoded, type encoded,
+ *		message, signal, length, signed, scaling, offset, minimum, maximum) */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+static OBJ o;
+
+typedef struct {
+	const char *name;
+	unsigned length;
+	int is_signed;
+	double scaling, offset, minimum, maximum;
+} signal_t;
+
+/* raw values are handled as an offset 'u' from the lowest value of the
+ * signal, as dbcc does, so that signed and unsigned signals are ordered the
+ * same way */
+static int64_t raw_signed(const signal_t *s, uint64_t u)
+{
+	const uint64_t half = 1uLL << (s->length - 1);
+	return u >= half ? (int64_t)(u - half) : -(int64_t)(half - u - 1) - 1;
+}
+
+static uint64_t raw_top(const signal_t *s)
+{
+	return s->length >= 64 ? UINT64_MAX : (1uLL << s->length) - 1;
+}
+
+static double physical(const signal_t *s, uint64_t u)
+{
+	double v = s->is_signed ? (double)raw_signed(s, u) : (double)u;
+	if (s->scaling != 1.0)
+		v *= s->scaling;
+	if (s->offset != 0.0)
+		v += s->offset;
+	return v;
+}
+
+static int above(const signal_t *s, uint64_t u, double limit, int at_least)
+{
+	const double v = physical(s, u);
+	return at_least ? v >= limit : v <= limit;
+}
+
+/* the first or last raw value for which 'above' holds, which changes once
+ * over the raw values, zero if it never holds */
+static int search(const signal_t *s, double limit, int at_least, int first, uint64_t *u)
+{
+	uint64_t lo = 0, hi = raw_top(s);
+	if (!above(s, first ? hi : lo, limit, at_least))
+		return 0;
+	while (lo < hi) {
+		if (first) {
+			const uint64_t mid = lo + (hi - lo) / 2;
+			if (above(s, mid, limit, at_least))
+				hi = mid;
+			else
+				lo = mid + 1;
+		} else {
+			const uint64_t mid = hi - (hi - lo) / 2;
+			if (above(s, mid, limit, at_least))
+				lo = mid;
+			else
+				hi = mid - 1;
+		}
+	}
+	*u = lo;
+	return 1;
+}
+
+/* the valid raw values [lo, hi], zero if there are none */
+static int valid_range(const signal_t *s, uint64_t *lo, uint64_t *hi)
+{
+	if (s->scaling > 0.0)
+		return search(s, s->minimum, 1, 1, lo) && search(s, s->maximum, 0, 0, hi) && *lo <= *hi;
+	return search(s, s->maximum, 0, 1, lo) && search(s, s->minimum, 1, 0, hi) && *lo <= *hi;
+}
+
+/* a minimum or maximum outside of the values the signal can hold is not
+ * encoded, it does not fit in every type an encode function can take */
+static int representable(const signal_t *s, double v)
+{
+	const double a = physical(s, 0), b = physical(s, raw_top(s));
+	return a < b ? v >= a && v <= b : v >= b && v <= a;
+}
+
+static unsigned long failures = 0;
+
+static void failed(const signal_t *s, const char *what, uint64_t u)
+{
+	fprintf(stderr, "%s: %s, raw offset %"PRIu64"\n", s->name, what, u);
+	failures++;
+}
+
+static uint64_t to_offset(const signal_t *s, int64_t r)
+{
+	const uint64_t half = 1uLL << (s->length - 1);
+	return r >= 0 ? (uint64_t)r + half : half - (uint64_t)(-(r + 1)) - 1;
+}
+
+/* store a raw value, given as an offset, in the field of a signal */
+#define STORE(message, signal, s, u) do {\
+	if ((s)->is_signed)\
+		o.message.signal = raw_signed((s), (u));\
+	else\
+		o.message.signal = (u);\
+} while (0)
+#define LOAD(message, signal, s) ((s)->is_signed ? to_offset((s), (int64_t)o.message.signal) : (uint64_t)o.message.signal)
+
+#define BOUNDS(decode, encode, dtype, etype, message, signal, length, is_signed, scaling, offset, minimum, maximum) do {\
+	const signal_t s = { #signal, length, is_signed, scaling, offset, minimum, maximum };\
+	uint64_t lo = 1, hi = 0, u[4];\
+	const int any = valid_range(&s, &lo, &hi);\
+	unsigned n = 0;\
+	if (any && lo > 0)\
+		u[n++] = lo - 1;\
+	if (any)\
+		u[n++] = lo, u[n++] = hi;\
+	if (any && hi < raw_top(&s))\
+		u[n++] = hi + 1;\
+	for (unsigned i = 0; i < n; i++) {\
+		const int valid = any && u[i] >= lo && u[i] <= hi;\
+		dtype value = 0;\
+		STORE(message, signal, &s, u[i]);\
+		const int r = decode(&o, &value);\
+		if ((r == 0) != valid)\
+			failed(&s, valid ? "decode rejects a valid value" : "decode accepts an invalid value", u[i]);\
+		else if (valid && (double)value != (double)(dtype)physical(&s, u[i]))\
+			failed(&s, "decode gives a different value", u[i]);\
+		const int e = encode(&o, (etype)physical(&s, u[i]));\
+		if (valid && (e != 0 || LOAD(message, signal, &s) != u[i]))\
+			failed(&s, "a valid value does not encode back to its raw value", u[i]);\
+		else if (!valid && e == 0 && decode(&o, &value) != 0)\
+			failed(&s, "encode accepts a value decode rejects", u[i]);\
+		printf("%s %"PRIu64" %d %.17g %d\n", #signal, u[i], r, (double)value, e);\
+	}\
+	const double limits[2] = { minimum, maximum };\
+	for (unsigned i = 0; i < 2; i++) {\
+		dtype value = 0;\
+		if (!representable(&s, limits[i]))\
+			continue;\
+		const int e = encode(&o, (etype)limits[i]);\
+		if (e == 0 && decode(&o, &value) != 0)\
+			failed(&s, "encode accepts a value decode rejects", LOAD(message, signal, &s));\
+		printf("%s %s %d\n", #signal, i ? "maximum" : "minimum", e);\
+	}\
+	signals++;\
+} while (0)
+
+int main(void)
+{
+	unsigned long signals = 0;
+#include "bounds.h"
+	fprintf(stderr, "%lu signals\n", signals);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,331 @@
+#!/bin/sh
+# Regression tests for the C code generator, run by 'make test'.
+#
+# Every DBC file is compiled to C with each set of options below, the
+# generated code must compile without warnings and, unless the options leave
+# out pack or unpack code, pass the round trip test in 'roundtrip.c'. The
+# frames it prints must be the same as for the default options, and for the
+# default options the same as in 'expected/<dbc>.txt' if there is one. With
+# '-n' the messages kept and their pack and unpack functions must be those of
+# the messages the node sends and receives. Some variants run a test program
+# of their own as well, see run_test.
+set -u
+
+DBCC=${DBCC:-../dbcc}
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--std=c99 -Wall -Wextra -pedantic -O1 -fwrapv}
+OUT=${OUT:-out}
+DBCS=${DBCS:-"ex1 ex2 double_signal float_signal motorola wheels cells mux aligned groups strings"}
+
+# name, whether the round trip is run (r) or the code is only compiled (c),
+# and the options
+VARIANTS='
+default    r
+asserts    r -s
+time       r -t
+double     r -D
+layout     r -l
+repack     r -r
+format     r -f
+serialize  r -S
+bmi2       r -B
+bmi2shared r -B -d -m 2 -c
+words      r -w
+overlay    r -O
+tables     r -L 65536
+arrays     r -a
+unions     r -U
+sequence   r -q
+seqsplit   r -q -m 2 -B
+registry   r -R
+filters    r -F 4
+profile    r -P PROFILE
+shared     r -d
+sharedhdr  r -d -H -a
+sharedpart r -d -m 2 -c
+header     r -H
+split      r -m 3
+switches   r -c
+switchoff  c -c
+report     r -W
+cost       r -K COST
+node       c -n GW
+combined   r -l -w -O -a -U -q -d -L 1024
+'
+
+failures=0
+fail() {
+	echo "FAIL: $*"
+	failures=$((failures + 1))
+}
+
+# Build a test program for a variant, '<test>.c', with the generated code
+# and any further compiler options and run it, its output must be the same
+# as 'expected/<dbc>.<test>.txt' if there is one
+run_test() {
+	test=$1
+	shift
+	if ! $CC $CFLAGS -I "$base" -I "$dir" -include "$dir/$dbc.h" -DOBJ="$obj" "$@" "$test.c" $objects -lm -o "$dir/$test" 2>> "$dir/cc.log"; then
+		fail "$dbc $name: compiling $test.c"
+	elif ! "$dir/$test" < /dev/null > "$dir/$test.txt" 2> "$dir/$test.log"; then
+		fail "$dbc $name: $test, see $dir/$test.log"
+	elif [ -f "expected/$dbc.$test.txt" ] && ! cmp -s "expected/$dbc.$test.txt" "$dir/$test.txt"; then
+		fail "$dbc $name: $test output differs from expected/$dbc.$test.txt"
+	fi
+}
+
+# 'ex1.dbc' has a message without any signals, its empty structure is the
+# only warning that is not a failure of the generator
+warnings() {
+	if [ "$dbc" = ex1 ]; then
+		grep -e 'warning:' -e 'error:' | grep -v 'struct has no members'
+	else
+		grep -e 'warning:' -e 'error:'
+	fi
+}
+
+# The messages a node keeps (those it sends or receives) and their pack and
+# unpack functions, from the DBC file and from the generated code
+node_expected() {
+	awk -v node="$1" '
+	$1 == "BO_" {
+		id = $2; if (id >= 2147483648) id -= 2147483648
+		name = $3; sub(/:$/, "", name)
+		msg = sprintf("can_0x%03x_%s", id, name)
+		if ($NF == node) { print "message " msg; print "pack " msg }
+	}
+	$1 == "SG_" && msg != "" {
+		n = split($NF, receivers, ",")
+		for (i = 1; i <= n; i++)
+			if (receivers[i] == node && !(msg in rx)) { rx[msg] = 1; print "message " msg; print "unpack " msg }
+	}' "$2" | sort -u
+}
+
+node_generated() {
+	{
+		sed -n 's/^} POSTPACK \(can_0x[0-9a-f]*_[A-Za-z0-9_]*\)_t;$/message \1/p' "$1.h"
+		grep -o 'int \(un\)\{0,1\}pack_can_0x[0-9a-f]*_[A-Za-z0-9_]*(' "$1.c" | sed 's/^int \([a-z]*\)_\(.*\)($/\1 \2/'
+	} | sort -u
+}
+
+# A line for each repack and patch function in a header for 'repack.c', with
+# the start bit, length and byte order of its signal from the DBC file
+repack_tests() {
+	awk '
+	FNR == NR && $1 == "BO_" { id = $2; if (id >= 2147483648) id -= 2147483648 }
+	FNR == NR && $1 == "SG_" {
+		match($0, /[0-9]+\|[0-9]+@[01]/)
+		split(substr($0, RSTART, RLENGTH), f, /[|@]/)
+		name = $2; sub(/:$/, "", name)
+		signal[sprintf("can_0x%03x_%s", id, name)] = f[1] ", " f[2] ", " (f[3] == "0")
+	}
+	FNR == NR { next }
+	/^int (repack|patch)_can_0x[0-9a-f]+_[A-Za-z0-9_]+\(uint64_t \*frame, [a-z0-9_]+ in\);$/ {
+		function_name = $2; sub(/\(.*/, "", function_name)
+		key = function_name; sub(/^[a-z]+_/, "", key)
+		kind = toupper(substr(function_name, 1, index(function_name, "_") - 1))
+		if (key in signal)
+			printf "\t%s(%s, %s, %s);\n", kind, function_name, $4, signal[key]
+		else
+			printf "#error \"no signal for %s\"\n", function_name
+	}' "$1" "$2"
+}
+
+# A line for each signal that '-L' could decode with a table, in a header
+# for 'tables.c', with the range of its raw values from the DBC file
+tables_tests() {
+	awk '
+	FNR == NR && $1 == "BO_" {
+		id = $2; if (id >= 2147483648) id -= 2147483648
+		message = $3; sub(/:$/, "", message)
+	}
+	FNR == NR && $1 == "SG_" {
+		match($0, /[0-9]+\|[0-9]+@[01][+-] *\([^,]*,[^)]*\)/)
+		split(substr($0, RSTART, RLENGTH), f, /[|@(,)]/)
+		name = $2; sub(/:$/, "", name)
+		length_ = f[2] + 0; signed = substr(f[3], 2, 1) == "-"
+		if (length_ <= 8 && (f[4] + 0 != 1 || f[5] + 0 != 0))
+			signal[sprintf("can_0x%03x_%s", id, name)] = sprintf("can_0x%03x_%s, %s, %d, %d", id, message, name,
+				signed ? -2 ^ (length_ - 1) : 0, signed ? 2 ^ (length_ - 1) - 1 : 2 ^ length_ - 1)
+	}
+	FNR == NR { next }
+	/^int decode_can_0x[0-9a-f]+_[A-Za-z0-9_]+\(const can_obj_[A-Za-z0-9_]+ \*o, [a-z0-9_]+ \*out\);$/ {
+		function_name = $2; sub(/\(.*/, "", function_name)
+		key = function_name; sub(/^decode_/, "", key)
+		if (key in signal)
+			printf "\tDECODE(%s, %s, %s);\n", function_name, $5, signal[key]
+	}' "$1" "$2"
+}
+
+# A line for each integer signal with a range in a header for 'bounds.c',
+# with its type, scaling and range from the DBC file, the constants printed
+# as they are in the generated code
+bounds_tests() {
+	awk '
+	FNR == NR && $1 == "BO_" {
+		id = $2; if (id >= 2147483648) id -= 2147483648
+		message = $3; sub(/:$/, "", message)
+	}
+	FNR == NR && $1 == "SG_" {
+		match($0, /[0-9]+\|[0-9]+@[01][+-] *\([^)]*\) *\[[^]]*\]/)
+		split(substr($0, RSTART, RLENGTH), f, /[|@(,)[\]]/)
+		name = $2; sub(/:$/, "", name)
+		if (f[7] + 0 != f[8] + 0)
+			signal[sprintf("can_0x%03x_%s", id, name)] = sprintf("can_0x%03x_%s, %s, %d, %d, %g, %g, %g, %g",
+				id, message, name, f[2], substr(f[3], 2, 1) == "-", f[4], f[5], f[7], f[8])
+	}
+	FNR == NR && $1 == "SIG_VALTYPE_" {
+		id = $2; if (id >= 2147483648) id -= 2147483648
+		floating[sprintf("can_0x%03x_%s", id, $3)] = 1
+	}
+	FNR == NR { next }
+	/^int decode_can_0x[0-9a-f]+_[A-Za-z0-9_]+\(const can_obj_[A-Za-z0-9_]+ \*o, [a-z0-9_]+ \*out\);$/ {
+		key = $2; sub(/\(.*/, "", key); sub(/^decode_/, "", key)
+		decoded[key] = $5
+	}
+	/^int encode_can_0x[0-9a-f]+_[A-Za-z0-9_]+\(can_obj_[A-Za-z0-9_]+ \*o, [a-z0-9_]+ in\);$/ {
+		key = $2; sub(/\(.*/, "", key); sub(/^encode_/, "", key)
+		if ((key in signal) && (key in decoded) && !(key in floating))
+			printf "\tBOUNDS(decode_%s, encode_%s, %s, %s, %s);\n", key, key, decoded[key], $4, signal[key]
+	}' "$1" "$2"
+}
+
+# A line for each message in a header for 'filters.c', extended identifiers
+# have bit 31 set in the DBC file
+filters_tests() {
+	awk '$1 == "BO_" {
+		id = $2; extended = id >= 2147483648
+		if (extended) id -= 2147483648
+		printf "\tRECEIVED(0x%x, %d);\n", id, extended
+	}' "$1"
+}
+
+# A line for each message, encode function and signal group in a header for
+# 'sequence.c', from the generated header
+sequence_tests() {
+	awk '
+	/^\tvolatile unsigned can_0x[0-9a-f]+_[A-Za-z0-9_]+_seq;$/ {
+		name = $3; sub(/_seq;$/, "", name)
+		id = name; sub(/^can_/, "", id); sub(/_.*/, "", id)
+		message[id] = name
+		messages = messages sprintf("\tMESSAGE(%s, %s);\n", id, name)
+	}
+	/^int encode_can_0x[0-9a-f]+_[A-Za-z0-9_]+\(can_obj_[A-Za-z0-9_]+ \*o, [a-z0-9_]+ in\);$/ {
+		name = $2; sub(/\(.*/, "", name)
+		id = name; sub(/^encode_can_/, "", id); sub(/_.*/, "", id)
+		encodes = encodes sprintf("\tENCODE(%s, %s);\n", name, message[id])
+	}
+	/^int get_group_can_0x[0-9a-f]+_[A-Za-z0-9_]+\(const can_obj_[A-Za-z0-9_]+ \*o, [A-Za-z0-9_]+ \*out\);$/ {
+		name = $2; sub(/\(.*/, "", name)
+		id = name; sub(/^get_group_can_/, "", id); sub(/_.*/, "", id)
+		set = name; sub(/^get_/, "set_", set)
+		groups = groups sprintf("\tGROUP(%s, %s, %s, %s);\n", name, set, $5, message[id])
+	}
+	END { printf "%s%s%s", messages, groups, encodes }' "$1"
+}
+
+for dbc in $DBCS; do
+	src=../$dbc.dbc
+	test -f "$src" || src=$dbc.dbc
+	base=$OUT/$dbc
+	mkdir -p "$base"
+	# the messages and their DLC, extended identifiers have bit 31 set
+	awk '$1 == "BO_" {
+		id = $2; dlc = ($4 == ":") ? $5 : $4
+		if (id >= 2147483648) id -= 2147483648
+		printf "\t{ %.0f, %d },\n", id, dlc
+	}' "$src" > "$base/frames.list"
+	{ echo 'static const frame_t frames[] = {'; cat "$base/frames.list"; echo '};'; } > "$base/frames.h"
+	awk '{ gsub(/[{},]/, ""); printf "0x%x %d\n", $1, 1000 * NR }' "$base/frames.list" > "$base/profile.txt"
+	printf '# a 64-bit target with a single precision FPU\nword 64\nfloat 4 4\ncall 3\n' > "$base/cost.txt"
+
+	while read -r name mode flags; do
+		test -n "$name" || continue
+		dir=$base/$name
+		rm -rf "$dir"
+		mkdir -p "$dir"
+		flags=$(echo "$flags" | sed -e "s#PROFILE#$base/profile.txt#" -e "s#COST#$base/cost.txt#")
+		if ! $DBCC $flags -o "$dir" "$src" < /dev/null > "$dir/dbcc.log" 2>&1; then
+			fail "$dbc $name: dbcc $flags"
+			continue
+		fi
+		sources=$dir/$dbc.c
+		test -f "$dir/$dbc.files" && sources=$(sed "s#^#$dir/#" "$dir/$dbc.files")
+		defines=
+		if [ "$name" = switchoff ]; then
+			sed 's/ (1)$/ (0)/' "$dir"/dbcc_*_config.h > "$dir/off.h"
+			mv "$dir/off.h" "$dir"/dbcc_*_config.h
+			defines=-D$(grep '^#ifndef' "$dir"/dbcc_*_config.h | head -1 | sed -e 's/^#ifndef //' -e 's/_H$//')
+		fi
+		: > "$dir/cc.log"
+		objects=
+		for c in $sources; do
+			o=${c%.c}.o
+			$CC $CFLAGS $defines -c "$c" -o "$o" 2>> "$dir/cc.log" || fail "$dbc $name: compiling $c"
+			objects="$objects $o"
+		done
+		if [ -n "$(warnings < "$dir/cc.log")" ]; then
+			fail "$dbc $name: warnings, see $dir/cc.log"
+		fi
+		case "$flags" in
+		*-W*|*-K*) test -s "$dir/${dbc}_cost.csv" || fail "$dbc $name: no report";;
+		esac
+		node=$(echo "$flags" | sed -n 's/.*-n \([^ ]*\).*/\1/p')
+		if [ -n "$node" ]; then
+			node_expected "$node" "$src" > "$dir/node.expected"
+			node_generated "$dir/$dbc" > "$dir/node.txt"
+			cmp -s "$dir/node.expected" "$dir/node.txt" ||
+				fail "$dbc $name: messages or functions kept for node $node differ, see $dir/node.txt"
+		fi
+		obj=$(sed -n 's/^}.* \(can_obj_[A-Za-z0-9_]*_t\);$/\1/p' "$dir/$dbc.h" | head -1)
+		case "$name" in
+		repack) repack_tests "$src" "$dir/$dbc.h" > "$dir/repack.h" && run_test repack;;
+		format) run_test format;;
+		serialize) run_test serialize;;
+		filters) filters_tests "$src" > "$dir/filters.h" && run_test filters -DBANKS="$(echo "$flags" | sed -n 's/.*-F \([0-9]*\).*/\1/p')" \
+			-DFILTERS="$(sed -n 's/^extern const dbcc_filter_t \(can_filters_[A-Za-z0-9_]*\)\[.*/\1/p' "$dir/$dbc.h")";;
+		registry) run_test registry -DREGISTRY="$(sed -n 's/^} \(can_registry_[A-Za-z0-9_]*_t\);$/\1/p' "$dir/$dbc.h")";;
+		esac
+		case "$name" in
+		default|double|tables) bounds_tests "$src" "$dir/$dbc.h" > "$dir/bounds.h" && run_test bounds;;
+		esac
+		if [ "$name" = double ] || [ "$name" = tables ] && ! cmp -s "$base/default/bounds.txt" "$dir/bounds.txt"; then
+			fail "$dbc $name: range checks differ from the default options, see $dir/bounds.txt"
+		fi
+		case "$name" in
+		default|tables) tables_tests "$src" "$dir/$dbc.h" > "$dir/tables.h" && run_test tables;;
+		esac
+		if [ "$name" = tables ] && ! cmp -s "$base/default/tables.txt" "$dir/tables.txt"; then
+			fail "$dbc $name: decoding with tables differs from the default options, see $dir/tables.txt"
+		fi
+		case "$name" in
+		sequence|seqsplit|combined) sequence_tests "$dir/$dbc.h" > "$dir/sequence.h" && run_test sequence;;
+		esac
+		if [ "$name" = seqsplit ] && ! cmp -s "$base/sequence/sequence.txt" "$dir/sequence.txt"; then
+			fail "$dbc $name: sequence counter test differs from '-q', see $dir/sequence.txt"
+		fi
+		[ "$mode" = r ] || continue
+		if ! $CC $CFLAGS -I "$base" -include "$dir/$dbc.h" -DOBJ="$obj" roundtrip.c $objects -lm -o "$dir/roundtrip" 2>> "$dir/cc.log"; then
+			fail "$dbc $name: linking the round trip test"
+			continue
+		fi
+		if ! "$dir/roundtrip" < /dev/null > "$dir/frames.txt" 2> "$dir/roundtrip.log"; then
+			fail "$dbc $name: round trip, see $dir/roundtrip.log"
+			continue
+		fi
+		if [ "$name" != default ] && ! cmp -s "$base/default/frames.txt" "$dir/frames.txt"; then
+			fail "$dbc $name: frames differ from the default options"
+		fi
+		if [ "$name" = default ] && [ -f "expected/$dbc.txt" ] && ! cmp -s "expected/$dbc.txt" "$dir/frames.txt"; then
+			fail "$dbc $name: frames differ from expected/$dbc.txt"
+		fi
+	done <<EOF
+$VARIANTS
+EOF
+done
+
+if [ "$failures" -ne 0 ]; then
+	echo "$failures failures"
+	exit 1
+fi
+echo "all tests passed"
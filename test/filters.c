@@ -0,0 +1,47 @@
+/* Test of the acceptance filters generated with '-F', see 'check.sh'.
+ *
+ * Every message that is unpacked must be admitted by at least one of the
+ * filters: one for the same kind of identifier, standard or extended, whose
+ * 'id' equals the identifier in every bit set in its 'mask'. There must be
+ * no more filters than the banks asked for.
+ *
+ * Built with '-include' for the generated header, FILTERS defined as the
+ * filter table, BANKS as the number of banks and 'filters.h' generated from
+ * the DBC file, a line for each message:
+ *
+ *	RECEIVED(id, extended) */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+static unsigned long failures = 0;
+
+static int admitted(unsigned long id, int extended)
+{
+	for (size_t i = 0; i < sizeof(FILTERS) / sizeof(FILTERS[0]); i++) {
+		const dbcc_filter_t *f = &FILTERS[i];
+		if (f->extended == extended && ((id ^ f->id) & f->mask) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+#define RECEIVED(id, extended) do {\
+	if (!admitted((id), (extended))) {\
+		fprintf(stderr, "0x%lx: not admitted by any filter\n", (unsigned long)(id));\
+		failures++;\
+	}\
+	messages++;\
+} while (0)
+
+int main(void)
+{
+	unsigned long messages = 0;
+	if (sizeof(FILTERS) / sizeof(FILTERS[0]) > BANKS) {
+		fprintf(stderr, "%lu filters for %d banks\n", (unsigned long)(sizeof(FILTERS) / sizeof(FILTERS[0])), BANKS);
+		failures++;
+	}
+#include "filters.h"
+	fprintf(stderr, "%lu messages\n", messages);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
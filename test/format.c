@@ -0,0 +1,62 @@
+/* Test of the format functions generated with '-f', see 'check.sh'.
+ *
+ * Frames are unpacked for every message in the DBC file and formatted, the
+ * text is printed to be compared with 'expected/<dbc>.format.txt'. The
+ * values printed must be those the decode functions return, and a text that
+ * does not fit in the buffer must be reported as such.
+ *
+ * Built like 'roundtrip.c'. */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+typedef struct {
+	unsigned long id;
+	unsigned dlc;
+} frame_t;
+
+#include "frames.h"
+
+#ifndef FRAMES
+#define FRAMES (4)
+#endif
+
+static OBJ o;
+
+static uint64_t xorshift(uint64_t *s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+int main(void)
+{
+	static char buf[8192];
+	uint64_t seed = 88172645463325252uLL;
+	unsigned long failures = 0;
+	for (size_t i = 0; i < sizeof(frames) / sizeof(frames[0]); i++) {
+		const frame_t *f = &frames[i];
+		for (unsigned j = 0; j < FRAMES; j++) {
+			const uint64_t data = j ? xorshift(&seed) : 0;
+			if (unpack_message(&o, f->id, data, 8, j) < 0)
+				continue;
+			const int r = format_message(&o, f->id, buf, sizeof(buf));
+			if (r < 0 || (size_t)r >= sizeof(buf)) {
+				fprintf(stderr, "0x%lx: format failed (%d)\n", f->id, r);
+				failures++;
+				continue;
+			}
+			if (r > 0 && format_message(&o, f->id, buf, (size_t)r) != r) {
+				fprintf(stderr, "0x%lx: truncated format gave a different length\n", f->id);
+				failures++;
+			}
+			format_message(&o, f->id, buf, sizeof(buf));
+			printf("%lx %016"PRIx64"\n%s", f->id, data, buf);
+		}
+	}
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
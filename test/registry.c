@@ -0,0 +1,81 @@
+/* Test of the registry generated with '-R', see 'check.sh'.
+ *
+ * Frames for every message in the DBC file are dispatched with the message
+ * enabled, which must unpack it as 'unpack_message' does and call its
+ * callback once, and with the message disabled, which must return zero
+ * without touching the CAN object or calling the callback.
+ *
+ * Built like 'roundtrip.c', with REGISTRY defined as the registry type. */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+	unsigned long id;
+	unsigned dlc;
+} frame_t;
+
+#include "frames.h"
+
+#ifndef FRAMES
+#define FRAMES (4)
+#endif
+
+static OBJ o, expected, before;
+
+static unsigned long calls = 0, last = 0, failures = 0;
+
+static void callback(OBJ *obj, unsigned long id, void *arg)
+{
+	if (obj != &o || arg != &calls) {
+		fprintf(stderr, "0x%lx: callback with the wrong arguments\n", id);
+		failures++;
+	}
+	calls++;
+	last = id;
+}
+
+static uint64_t xorshift(uint64_t *s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+int main(void)
+{
+	static REGISTRY registry;
+	uint64_t seed = 88172645463325252uLL;
+	init_registry(&registry, 1);
+	for (size_t i = 0; i < sizeof(frames) / sizeof(frames[0]); i++) {
+		const frame_t *f = &frames[i];
+		if (subscribe_message(&registry, f->id, callback, &calls) < 0) {
+			fprintf(stderr, "0x%lx: cannot subscribe\n", f->id);
+			failures++;
+		}
+		for (unsigned j = 0; j < FRAMES; j++) {
+			const uint64_t data = j ? xorshift(&seed) : 0;
+			const int e = unpack_message(&expected, f->id, data, 8, j);
+			calls = 0;
+			if (dispatch_message(&registry, &o, f->id, data, 8, j) != e || memcmp(&o, &expected, sizeof(o))) {
+				fprintf(stderr, "0x%lx: dispatching differs from unpacking\n", f->id);
+				failures++;
+			}
+			if (calls != (e == 0) || (calls && last != f->id)) {
+				fprintf(stderr, "0x%lx: callback called %lu times\n", f->id, calls);
+				failures++;
+			}
+			enable_message(&registry, f->id, 0);
+			memcpy(&before, &o, sizeof(o));
+			calls = 0;
+			if (dispatch_message(&registry, &o, f->id, ~data, 8, j + 1) != 0 || memcmp(&o, &before, sizeof(o)) || calls) {
+				fprintf(stderr, "0x%lx: a disabled message was unpacked\n", f->id);
+				failures++;
+			}
+			enable_message(&registry, f->id, 1);
+		}
+	}
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
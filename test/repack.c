@@ -0,0 +1,87 @@
+/* Test of the repack and patch functions generated with '-r', see 'check.sh'.
+ *
+ * Every signal is repacked and patched into random frames. The bits of the
+ * frame outside of the signal must be left as they were, and the bits of the
+ * signal must not depend on what was in the frame before. A patch that fails
+ * its range check must not change the frame at all.
+ *
+ * Built with '-include' for the generated header and with 'repack.h'
+ * generated from the DBC file and the header, a line for each function:
+ *
+ *	REPACK(function, type of the value, start bit, length, motorola)
+ *	PATCH(function, type of the value, start bit, length, motorola) */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#ifndef FRAMES
+#define FRAMES (64)
+#endif
+
+/* The bits of a frame a signal takes up, Motorola signals start at their
+ * most significant bit and go down, to the next byte after bit 0 of one */
+static uint64_t signal_bits(unsigned start, unsigned length, int motorola)
+{
+	uint64_t bits = 0;
+	for (unsigned i = 0, bit = start; i < length && bit < 64; i++) {
+		bits |= 1uLL << bit;
+		if (!motorola)
+			bit++;
+		else if (bit % 8 == 0)
+			bit += 15;
+		else
+			bit--;
+	}
+	return bits;
+}
+
+static uint64_t xorshift(uint64_t *s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+static unsigned long failures = 0;
+
+static void check(const char *function, int r, uint64_t before, uint64_t after, uint64_t inverted, uint64_t bits)
+{
+	if (r < 0 && before != after) {
+		fprintf(stderr, "%s: failed but changed %016"PRIx64" to %016"PRIx64"\n", function, before, after);
+		failures++;
+	} else if (r >= 0 && ((before ^ after) & ~bits)) {
+		fprintf(stderr, "%s: changed %016"PRIx64" to %016"PRIx64", outside of %016"PRIx64"\n", function, before, after, bits);
+		failures++;
+	} else if (r >= 0 && ((after ^ inverted) & bits)) {
+		fprintf(stderr, "%s: gave %016"PRIx64" and %016"PRIx64" in %016"PRIx64"\n", function, after, inverted, bits);
+		failures++;
+	}
+}
+
+/* the value is small enough for every type of value */
+#define REPACK(function, type, start, length, motorola) do {\
+	const uint64_t bits = signal_bits(start, length, motorola);\
+	uint64_t after = frame, inverted = ~frame;\
+	const int r = function(&after, (type)(value & 0x7f));\
+	if (function(&inverted, (type)(value & 0x7f)) != r)\
+		fprintf(stderr, "%s: result depends on the frame\n", #function), failures++;\
+	check(#function, r, frame, after, inverted, bits);\
+	functions++;\
+} while (0)
+
+#define PATCH(function, type, start, length, motorola) REPACK(function, type, start, length, motorola)
+
+int main(void)
+{
+	uint64_t seed = 88172645463325252uLL;
+	unsigned long functions = 0;
+	for (unsigned j = 0; j < FRAMES; j++) {
+		const uint64_t frame = xorshift(&seed), value = xorshift(&seed) >> 32;
+		functions = 0;
+#include "repack.h"
+	}
+	printf("%lu functions\n", functions);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+/* Round trip test for the code generated from a DBC file, see 'check.sh'.
+ *
+ * Random frames are unpacked and packed again for every message in the DBC
+ * file, which projects each frame onto the bits the signals of the message
+ * use. Unpacking and packing that projection must give it back unchanged.
+ * The projection is printed, so the output of every code generator option
+ * can be compared with the output of the default options. Frames with a
+ * multiplexor value no signal uses are rejected, which is printed as well.
+ * Frames shorter than the DLC of a message must be rejected.
+ *
+ * Built with '-include' for the generated header, 'OBJ' defined as the type
+ * of the CAN object and with 'frames.h' generated from the DBC file. */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+typedef struct {
+	unsigned long id;
+	unsigned dlc;
+} frame_t;
+
+#include "frames.h"
+
+#ifndef FRAMES
+#define FRAMES (256)
+#endif
+
+static OBJ o1, o2;
+
+static uint64_t xorshift(uint64_t *s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+int main(void)
+{
+	uint64_t seed = 88172645463325252uLL;
+	unsigned long failures = 0;
+	for (size_t i = 0; i < sizeof(frames) / sizeof(frames[0]); i++) {
+		const frame_t *f = &frames[i];
+		if (f->dlc && unpack_message(&o1, f->id, 0, f->dlc - 1, 0) >= 0) {
+			fprintf(stderr, "0x%lx: frame shorter than its DLC (%u) accepted\n", f->id, f->dlc);
+			failures++;
+		}
+		for (unsigned j = 0; j < FRAMES; j++) {
+			const uint64_t data = j ? xorshift(&seed) : 0;
+			uint64_t p1 = 0, p2 = 0;
+			if (unpack_message(&o1, f->id, data, 8, j) < 0) {
+				printf("%lx rejected\n", f->id);
+				continue;
+			}
+			if (pack_message(&o1, f->id, &p1) < 0) {
+				fprintf(stderr, "0x%lx: pack failed\n", f->id);
+				failures++;
+				break;
+			}
+			if (unpack_message(&o2, f->id, p1, 8, j) < 0 || pack_message(&o2, f->id, &p2) < 0 || p1 != p2) {
+				fprintf(stderr, "0x%lx: round trip of %016"PRIx64" gave %016"PRIx64"\n", f->id, p1, p2);
+				failures++;
+				break;
+			}
+			printf("%lx %016"PRIx64"\n", f->id, p1);
+		}
+	}
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+/* Test of the sequence counters generated with '-q', see 'check.sh'.
+ *
+ * The counter of a message must be even whenever no write is in progress,
+ * and every write of the message must advance it by two: unpacking a frame,
+ * encoding a signal and setting a signal group. Packing a frame only reads
+ * the message and must leave the counter as it is. A group that is set to
+ * the values it was got with must give the same values again. The results
+ * are printed to be compared with the output for other options.
+ *
+ * Built with '-include' for the generated header and with 'sequence.h'
+ * generated from the header, a line for each message, signal and group:
+ *
+ *	MESSAGE(id, message)
+ *	ENCODE(function, message)
+ *	GROUP(get function, set function, type, message) */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#ifndef FRAMES
+#define FRAMES (4)
+#endif
+
+static OBJ o;
+
+static uint64_t xorshift(uint64_t *s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+static unsigned long failures = 0;
+
+static void check(const char *name, const char *what, unsigned before, unsigned after, unsigned advance)
+{
+	if ((after & 1u) || after != before + advance) {
+		fprintf(stderr, "%s: %s moved the counter from %u to %u\n", name, what, before, after);
+		failures++;
+	}
+}
+
+#define MESSAGE(id, message) do {\
+	for (unsigned j = 0; j < FRAMES; j++) {\
+		const uint64_t data = j ? xorshift(&seed) : 0;\
+		uint64_t packed = 0;\
+		unsigned seq = o.message##_seq;\
+		const int r = unpack_message(&o, id, data, 8, j);\
+		check(#message, "unpack", seq, o.message##_seq, 2u);\
+		seq = o.message##_seq;\
+		const int p = pack_message(&o, id, &packed);\
+		check(#message, "pack", seq, o.message##_seq, 0u);\
+		printf("%s %016"PRIx64" %d %d\n", #message, data, r, p);\
+	}\
+} while (0)
+
+#define ENCODE(function, message) do {\
+	const unsigned seq = o.message##_seq;\
+	const int e = function(&o, 0);\
+	check(#function, "encode", seq, o.message##_seq, 2u);\
+	printf("%s %d\n", #function, e);\
+} while (0)
+
+#define GROUP(get, set, type, message) do {\
+	type a, b;\
+	memset(&a, 0, sizeof(a));\
+	memset(&b, 0, sizeof(b));\
+	unsigned seq = o.message##_seq;\
+	const int g = get(&o, &a);\
+	check(#get, "get", seq, o.message##_seq, 0u);\
+	seq = o.message##_seq;\
+	const int s = set(&o, &a);\
+	check(#set, "set", seq, o.message##_seq, 2u);\
+	if (g == 0 && (s != 0 || get(&o, &b) != 0 || memcmp(&a, &b, sizeof(a)))) {\
+		fprintf(stderr, "%s: a group set to its values gives other values\n", #set);\
+		failures++;\
+	}\
+	printf("%s %d %d\n", #get, g, s);\
+} while (0)
+
+int main(void)
+{
+	uint64_t seed = 88172645463325252uLL;
+#include "sequence.h"
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+/* Test of the serializers generated with '-S', see 'check.sh'.
+ *
+ * Frames are unpacked for every message in the DBC file and serialized as
+ * JSON, CSV and binary, the binary records printed in hexadecimal, to be
+ * compared with 'expected/<dbc>.serialize.txt'. The low byte of the random
+ * frames takes small values, so that the multiplexor at the start of a frame
+ * selects some of its signals. Serializing into a buffer one byte too short
+ * must return the same length without writing past it.
+ *
+ * Built like 'roundtrip.c'. */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+typedef struct {
+	unsigned long id;
+	unsigned dlc;
+} frame_t;
+
+#include "frames.h"
+
+#ifndef FRAMES
+#define FRAMES (6)
+#endif
+
+static OBJ o;
+
+static uint64_t xorshift(uint64_t *s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+static const char *names[] = { "json", "csv", "bin", };
+
+int main(void)
+{
+	static char buf[8192], fence[8192];
+	uint64_t seed = 88172645463325252uLL;
+	unsigned long failures = 0;
+	for (size_t i = 0; i < sizeof(frames) / sizeof(frames[0]); i++) {
+		const frame_t *f = &frames[i];
+		for (unsigned j = 0; j < FRAMES; j++) {
+			const uint64_t data = j ? (xorshift(&seed) & ~0xffuLL) | (j - 1) : 0;
+			if (unpack_message(&o, f->id, data, 8, 1000u + j) < 0)
+				continue;
+			printf("%lx %016"PRIx64"\n", f->id, data);
+			for (int format = DBCC_SERIALIZE_JSON_E; format <= DBCC_SERIALIZE_BIN_E; format++) {
+				const int r = serialize_message(&o, f->id, (dbcc_serialize_e)format, buf, sizeof(buf));
+				if (r < 0 || (size_t)r >= sizeof(buf)) {
+					fprintf(stderr, "0x%lx: %s failed (%d)\n", f->id, names[format], r);
+					failures++;
+					continue;
+				}
+				memset(fence, 0x55, sizeof(fence));
+				if (r > 0 && (serialize_message(&o, f->id, (dbcc_serialize_e)format, fence, (size_t)r - 1) != r || fence[r - 1] != 0x55)) {
+					fprintf(stderr, "0x%lx: %s into a short buffer\n", f->id, names[format]);
+					failures++;
+				}
+				if (format != DBCC_SERIALIZE_BIN_E) {
+					printf("%s", buf);
+					continue;
+				}
+				for (int k = 0; k < r; k++)
+					printf("%02x%s", (unsigned char)buf[k], k + 1 < r ? "" : "\n");
+			}
+		}
+	}
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
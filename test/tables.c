@@ -0,0 +1,36 @@
+/* Test of the decode lookup tables generated with '-L', see 'check.sh'.
+ *
+ * Every raw value of every signal that could be decoded with a table is
+ * stored in the CAN object and decoded, the value and the result of the
+ * decode function are printed. The output for the code generated with '-L'
+ * must be the same as for the default options, which decode with arithmetic.
+ *
+ * Built with '-include' for the generated header and with 'tables.h'
+ * generated from the DBC file and the header, a line for each signal:
+ *
+ *	DECODE(function, type of the value, message, signal, lowest, highest)
+ *
+ * where the lowest and highest raw values are those of its bit-width. */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+static OBJ o;
+
+#define DECODE(function, type, message, signal, lowest, highest) do {\
+	for (long raw = (lowest); raw <= (highest); raw++) {\
+		type value = 0;\
+		o.message.signal = raw;\
+		const int r = function(&o, &value);\
+		printf("%s %ld %d %.17g\n", #function, raw, r, (double)value);\
+		values++;\
+	}\
+} while (0)
+
+int main(void)
+{
+	unsigned long values = 0;
+#include "tables.h"
+	fprintf(stderr, "%lu values\n", values);
+	return EXIT_SUCCESS;
+}
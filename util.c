@@ -153,6 +153,38 @@ fail:
 	return NULL;
 }
 
+/* Replace the contents of a file only if they differ, leaving its time
+ * stamp alone so make does not rebuild it */
+int file_update(const char *path, FILE *contents)
+{
+	assert(path);
+	assert(contents);
+	char *now = slurp(contents);
+	if (!now)
+		return -1;
+	bool same = false;
+	FILE *old = fopen(path, "rb");
+	if (old) {
+		char *before = slurp(old);
+		same = before && !strcmp(before, now);
+		free(before);
+		fclose(old);
+	}
+	if (same) {
+		debug("%s is unchanged", path);
+	} else {
+		FILE *o = fopen_or_die(path, "wb");
+		const int r = fputs(now, o);
+		fclose(o);
+		if (r < 0) {
+			free(now);
+			return -1;
+		}
+	}
+	free(now);
+	return 0;
+}
+
 /* Stolen from musl-libc!
  * <https://www.musl-libc.org/download.html>
  *